@@ -0,0 +1,499 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Userspace benchmark for the ASUS mouse report decoders
+ *
+ * Copyright (c) 2022 Kyoken <kyoken@kyoken.ninja>
+ *
+ * Replays synthetic report streams for every report size handled by the driver,
+ * and optionally streams recorded from a real device, through the decoders
+ * the kernel module resolves for its reports at probe, and reports the
+ * per-report cost. Reports of unknown layouts are dropped like in the driver.
+ *
+ * Recorded streams are text files with one report per line:
+ *   <mouse|keyboard|gamepad> <hex byte> <hex byte> ...
+ * Empty lines and lines starting with '#' are ignored.
+ * Captures of the driver's debugfs ring are read in place through mmap,
+ * from the live "capture" file or from a copy of it.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "hid-asus-mouse.h"
+
+#define BENCH_STREAMS_MAX 64
+#define BENCH_REPORT_SIZE_MAX 64
+#define BENCH_CAPS (ASUS_MOUSE_CAP_JOYSTICK | ASUS_MOUSE_CAP_SIDE_BUTTONS)
+
+struct bench_report {
+	u32 application;
+	int size;
+	asus_mouse_decode_t decode;  /* NULL for unknown layouts */
+	u8 data[BENCH_REPORT_SIZE_MAX];
+};
+
+struct bench_stream {
+	char name[32];
+	u32 application;  /* 0 for streams mixing several interfaces */
+	int size;  /* 0 for streams mixing several report sizes */
+	size_t count;
+	size_t capacity;
+	struct bench_report *reports;
+};
+
+static struct bench_stream bench_streams[BENCH_STREAMS_MAX];
+static int bench_streams_num;
+
+static const char *bench_app_name(u32 application) {
+	switch(application) {
+	case HID_GD_MOUSE:
+		return "mouse";
+	case HID_GD_KEYBOARD:
+		return "keyboard";
+	case HID_GD_GAMEPAD:
+		return "gamepad";
+	default:
+		return "interleaved";
+	}
+}
+
+static u32 bench_seed = 0x12345678;
+
+static u32 bench_rand(void) {
+	/* xorshift32, deterministic across runs */
+	bench_seed ^= bench_seed << 13;
+	bench_seed ^= bench_seed >> 17;
+	bench_seed ^= bench_seed << 5;
+	return bench_seed;
+}
+
+static struct bench_stream *bench_stream_get(const char *prefix, u32 application, int size) {
+	struct bench_stream *stream;
+	int i;
+
+	for (i = 0; i < bench_streams_num; i++) {
+		stream = &bench_streams[i];
+		if (stream->application == application && stream->size == size &&
+				!strncmp(stream->name, prefix, strlen(prefix)))
+			return stream;
+	}
+
+	if (bench_streams_num >= BENCH_STREAMS_MAX) {
+		fprintf(stderr, "too many streams\n");
+		exit(1);
+	}
+
+	stream = &bench_streams[bench_streams_num++];
+	if (size)
+		snprintf(stream->name, sizeof(stream->name), "%s-%s-%d", prefix, bench_app_name(application), size);
+	else
+		snprintf(stream->name, sizeof(stream->name), "%s-%s", prefix, bench_app_name(application));
+	stream->application = application;
+	stream->size = size;
+	return stream;
+}
+
+static u8 *bench_stream_append(struct bench_stream *stream, u32 application, int size) {
+	const struct asus_mouse_layout *layout;
+	struct bench_report *report;
+
+	if (stream->count == stream->capacity) {
+		stream->capacity = stream->capacity ? stream->capacity * 2 : 1024;
+		stream->reports = realloc(stream->reports, stream->capacity * sizeof(*stream->reports));
+		if (!stream->reports) {
+			perror("realloc");
+			exit(1);
+		}
+	}
+
+	report = &stream->reports[stream->count++];
+	memset(report, 0, sizeof(*report));
+	report->application = application;
+	report->size = size;
+
+	/* resolved once like at probe, so the timed loop makes a single indirect call */
+	layout = asus_mouse_find_layout(application, size, BENCH_CAPS);
+	report->decode = layout ? layout->decode : NULL;
+	return report->data;
+}
+
+static int bench_random_key(void) {
+	int code;
+
+	/* pick a mapped key code, wheel keys included */
+	do {
+		code = bench_rand() % ASUS_MOUSE_MAPPING_SIZE;
+	} while (!asus_mouse_key_mapping[code]);
+
+	return code;
+}
+
+static void bench_gen_mouse(int size, size_t count) {
+	struct bench_stream *stream = bench_stream_get("synthetic", HID_GD_MOUSE, size);
+	int xo = (size == 11) ? 0 : 1;
+	int bo = (size == 6) ? 0 : (size == 7) ? 5 : 4;
+	int wo = (size == 7) ? 6 : 5;
+	u8 btn = 0;
+	s16 x, y;
+	size_t n;
+	u8 *r;
+
+	for (n = 0; n < count; n++) {
+		r = bench_stream_append(stream, HID_GD_MOUSE, size);
+		x = (s16)(bench_rand() % 65) - 32;
+		y = (s16)(bench_rand() % 65) - 32;
+		r[xo + 0] = x & 0xff;
+		r[xo + 1] = (x >> 8) & 0xff;
+		r[xo + 2] = y & 0xff;
+		r[xo + 3] = (y >> 8) & 0xff;
+		if (bench_rand() % 64 == 0)
+			btn ^= 1 << (bench_rand() % 5);
+		r[bo] = btn;
+		if (bench_rand() % 16 == 0)
+			r[wo] = (bench_rand() & 1) ? 1 : 0xff;
+	}
+}
+
+static void bench_gen_keyboard(int size, size_t count) {
+	struct bench_stream *stream = bench_stream_get("synthetic", HID_GD_KEYBOARD, size);
+	int first = (size == 8) ? 2 : 3;
+	int slots = size - first;
+	int i, code, keys;
+	size_t n;
+	u8 *r;
+
+	/* alternate between chords of 1..3 keys and all keys released */
+	for (n = 0; n < count; n++) {
+		r = bench_stream_append(stream, HID_GD_KEYBOARD, size);
+		if (n & 1)
+			continue;
+
+		keys = 1 + bench_rand() % 3;
+		for (i = 0; i < keys; i++) {
+			code = bench_random_key();
+			if (size == ASUS_MOUSE_KEYS_BITMASK_EVENT_SIZE) {
+				/* bitmask covers key codes 0...119 starting at byte 2 */
+				r[2 + code / 8] |= 1 << (code % 8);
+			} else if (i < slots) {
+				r[first + i] = code;
+			}
+		}
+	}
+}
+
+static void bench_gen_gamepad(int size, size_t count) {
+	struct bench_stream *stream = bench_stream_get("synthetic", HID_GD_GAMEPAD, size);
+	int xo = (size == 5) ? 1 : 0;
+	size_t n;
+	u8 *r;
+
+	/* sweep the stick over the whole range and back to the center */
+	for (n = 0; n < count; n++) {
+		r = bench_stream_append(stream, HID_GD_GAMEPAD, size);
+		r[xo + 0] = (n * 3) & 0xff;
+		r[xo + 1] = (n & 0x100) ? 128 : (n * 5) & 0xff;
+	}
+}
+
+/*
+ * Mixes the synthetic mouse, keyboard and gamepad streams the way a device
+ * with three interfaces delivers them: mostly motion, some keys and stick.
+ */
+static void bench_gen_interleaved(int mouse_size, int keyboard_size, int gamepad_size, size_t count) {
+	struct bench_stream *stream = bench_stream_get("synthetic", 0, 0);
+	struct bench_stream *src;
+	size_t n, pos[3] = { 0, 0, 0 };
+	u32 roll;
+	int i;
+
+	for (n = 0; n < count; n++) {
+		roll = bench_rand() % 16;
+		i = (roll < 12) ? 0 : (roll < 14) ? 1 : 2;
+		if (i == 0)
+			src = bench_stream_get("synthetic", HID_GD_MOUSE, mouse_size);
+		else if (i == 1)
+			src = bench_stream_get("synthetic", HID_GD_KEYBOARD, keyboard_size);
+		else
+			src = bench_stream_get("synthetic", HID_GD_GAMEPAD, gamepad_size);
+
+		memcpy(bench_stream_append(stream, src->application, src->size),
+			   src->reports[pos[i]].data, src->size);
+		pos[i] = (pos[i] + 1) % src->count;
+	}
+}
+
+static void bench_load(const char *path) {
+	char line[1024];
+	char *tok, *end;
+	u8 buf[BENCH_REPORT_SIZE_MAX];
+	u32 application;
+	int size, lineno = 0;
+	unsigned long byte;
+	FILE *f;
+
+	f = fopen(path, "r");
+	if (!f) {
+		perror(path);
+		exit(1);
+	}
+
+	while (fgets(line, sizeof(line), f)) {
+		lineno++;
+		tok = strtok(line, " \t\r\n");
+		if (!tok || tok[0] == '#')
+			continue;
+
+		if (!strcmp(tok, "mouse"))
+			application = HID_GD_MOUSE;
+		else if (!strcmp(tok, "keyboard"))
+			application = HID_GD_KEYBOARD;
+		else if (!strcmp(tok, "gamepad"))
+			application = HID_GD_GAMEPAD;
+		else {
+			fprintf(stderr, "%s:%d: unknown application '%s'\n", path, lineno, tok);
+			exit(1);
+		}
+
+		size = 0;
+		while ((tok = strtok(NULL, " \t\r\n"))) {
+			byte = strtoul(tok, &end, 16);
+			if (*end || byte > 0xff || size >= BENCH_REPORT_SIZE_MAX) {
+				fprintf(stderr, "%s:%d: bad report byte '%s'\n", path, lineno, tok);
+				exit(1);
+			}
+			buf[size++] = byte;
+		}
+
+		if (!size)
+			continue;
+
+		/* per layout, and in arrival order across all interfaces */
+		memcpy(bench_stream_append(bench_stream_get("recorded", application, size),
+								   application, size), buf, size);
+		memcpy(bench_stream_append(bench_stream_get("recorded", 0, 0),
+								   application, size), buf, size);
+	}
+
+	fclose(f);
+}
+
+/*
+ * Maps a capture ring read-only, the header tells its size since debugfs
+ * files have none. Copies of the ring made with "cp" are mapped the same way.
+ */
+static const struct asus_mouse_capture_header *bench_map_capture(const char *path, size_t *len) {
+	const struct asus_mouse_capture_header *header;
+	size_t page = sysconf(_SC_PAGESIZE);
+	struct stat st;
+	int fd;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0 || fstat(fd, &st)) {
+		perror(path);
+		exit(1);
+	}
+
+	if (st.st_size && (size_t)st.st_size < sizeof(*header)) {
+		fprintf(stderr, "%s: truncated capture\n", path);
+		exit(1);
+	}
+
+	header = mmap(NULL, page, PROT_READ, MAP_SHARED, fd, 0);
+	if (header == MAP_FAILED) {
+		perror(path);
+		exit(1);
+	}
+	*len = page;
+	if (asus_mouse_capture_valid(header, ~(size_t)0)) {
+		*len = header->records_offset + (u64)header->records * header->record_size;
+		munmap((void *)header, page);
+		if (st.st_size && (size_t)st.st_size < *len) {
+			fprintf(stderr, "%s: truncated capture\n", path);
+			exit(1);
+		}
+		header = mmap(NULL, *len, PROT_READ, MAP_SHARED, fd, 0);
+		if (header == MAP_FAILED) {
+			perror(path);
+			exit(1);
+		}
+	}
+
+	close(fd);
+	return header;
+}
+
+static void bench_load_capture(const char *path) {
+	const struct asus_mouse_capture_header *header;
+	const struct asus_mouse_capture_record *rec;
+	struct asus_mouse_capture_record copy;
+	unsigned long loaded = 0, lost = 0, skipped = 0;
+	u64 index, end;
+	size_t len;
+
+	header = bench_map_capture(path, &len);
+	if (!asus_mouse_capture_valid(header, len)) {
+		fprintf(stderr, "%s: not a capture ring of this driver version\n", path);
+		exit(1);
+	}
+
+	for (index = asus_mouse_capture_range(header, &end); index < end; index++) {
+		rec = asus_mouse_capture_record(header, index);
+		if (__atomic_load_n(&rec->seq, __ATOMIC_ACQUIRE) != index + 1) {
+			lost++;
+			continue;
+		}
+
+		/* the driver may overwrite the record while it is copied */
+		memcpy(&copy, rec, sizeof(copy));
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (__atomic_load_n(&rec->seq, __ATOMIC_RELAXED) != index + 1) {
+			lost++;
+			continue;
+		}
+
+		if (!asus_mouse_decodes_application(copy.application) ||
+				!copy.size || copy.size > ASUS_MOUSE_CAPTURE_DATA_MAX) {
+			skipped++;
+			continue;
+		}
+
+		memcpy(bench_stream_append(bench_stream_get("captured", copy.application, copy.size),
+								   copy.application, copy.size), copy.data, copy.size);
+		memcpy(bench_stream_append(bench_stream_get("captured", 0, 0),
+								   copy.application, copy.size), copy.data, copy.size);
+		loaded++;
+	}
+
+	munmap((void *)header, len);
+	fprintf(stderr, "%s: %lu reports, %lu overwritten, %lu of other applications or too long\n",
+			path, loaded, lost, skipped);
+}
+
+static u64 bench_now_ns(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (u64)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static u64 bench_cycles(void) {
+#if defined(__x86_64__) || defined(__i386__)
+	return __builtin_ia32_rdtsc();
+#else
+	return 0;  /* no cycle counter, only ns are reported */
+#endif
+}
+
+static unsigned int bench_pass(
+		struct bench_stream *stream, struct asus_mouse_decoder *dec, struct asus_mouse_events *evs) {
+	const struct bench_report *report;
+	unsigned int events = 0;
+	size_t n;
+
+	for (n = 0; n < stream->count; n++) {
+		report = &stream->reports[n];
+		if (!report->decode)
+			continue;
+		evs->count = 0;
+		report->decode(dec, report->data, evs);
+		events += evs->count;
+	}
+
+	return events;
+}
+
+static void bench_run(struct bench_stream *stream, int iterations) {
+	static struct asus_mouse_events evs;
+	struct asus_mouse_decoder dec = { .caps = BENCH_CAPS, .keymap = asus_mouse_key_mapping };
+	u64 events = 0, start, elapsed, cycles;
+	double reports, ns, rate;
+	int it;
+
+	/* warm up caches and branch predictors */
+	bench_pass(stream, &dec, &evs);
+
+	start = bench_now_ns();
+	cycles = bench_cycles();
+	for (it = 0; it < iterations; it++)
+		events += bench_pass(stream, &dec, &evs);
+	cycles = bench_cycles() - cycles;
+	elapsed = bench_now_ns() - start;
+
+	reports = (double)stream->count * iterations;
+	ns = elapsed / reports;
+	rate = ns > 0 ? 1e9 / ns : 0;
+	printf("%-28s %5d %10zu %10.2f %12.1f %14.0f %8.2f\n",
+		   stream->name, stream->size, stream->count, ns, cycles / reports, rate,
+		   events / reports);
+}
+
+static void usage(const char *prog) {
+	fprintf(stderr,
+			"Usage: %s [-n reports] [-i iterations] [-r recorded.txt]... [-c capture]... [-s]\n"
+			"  -n  synthetic reports per stream (default 100000)\n"
+			"  -i  timed passes over every stream (default 20)\n"
+			"  -r  add streams recorded from a device\n"
+			"  -c  add streams from the driver's capture ring or a copy of it\n"
+			"  -s  skip synthetic streams\n", prog);
+	exit(1);
+}
+
+int main(int argc, char **argv) {
+	static const int mouse_sizes[] = { 6, 7, 11 };
+	static const int keyboard_sizes[] = { 8, 9, 12, ASUS_MOUSE_KEYS_BITMASK_EVENT_SIZE };
+	static const int gamepad_sizes[] = { 4, 5 };
+	size_t count = 100000;
+	int iterations = 20;
+	bool synthetic = true;
+	unsigned int i;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "n:i:r:c:s")) != -1) {
+		switch(opt) {
+		case 'n':
+			count = strtoul(optarg, NULL, 0);
+			break;
+		case 'i':
+			iterations = atoi(optarg);
+			break;
+		case 'r':
+			bench_load(optarg);
+			break;
+		case 'c':
+			bench_load_capture(optarg);
+			break;
+		case 's':
+			synthetic = false;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+
+	if (!count || iterations <= 0)
+		usage(argv[0]);
+
+	if (synthetic) {
+		for (i = 0; i < sizeof(mouse_sizes) / sizeof(mouse_sizes[0]); i++)
+			bench_gen_mouse(mouse_sizes[i], count);
+		for (i = 0; i < sizeof(keyboard_sizes) / sizeof(keyboard_sizes[0]); i++)
+			bench_gen_keyboard(keyboard_sizes[i], count);
+		for (i = 0; i < sizeof(gamepad_sizes) / sizeof(gamepad_sizes[0]); i++)
+			bench_gen_gamepad(gamepad_sizes[i], count);
+		bench_gen_interleaved(7, 8, 4, count);
+	}
+
+	printf("%-28s %5s %10s %10s %12s %14s %8s\n",
+		   "stream", "size", "reports", "ns/report", "cycles/rep", "reports/sec", "events");
+
+	for (i = 0; i < (unsigned int)bench_streams_num; i++)
+		bench_run(&bench_streams[i], iterations);
+
+	return 0;
+}
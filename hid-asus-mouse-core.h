@@ -0,0 +1,750 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+#ifndef __HID_ASUS_MOUSE_CORE_H
+#define __HID_ASUS_MOUSE_CORE_H
+
+/*
+ * Copyright (c) 2022 Kyoken <kyoken@kyoken.ninja>
+ *
+ * Report decoders shared by the kernel module and the userspace tools.
+ * They take raw report bytes and produce a compact list of input events,
+ * without touching "struct input_dev" or any other kernel object.
+ */
+
+#ifdef __KERNEL__
+#include <linux/types.h>
+#include <linux/hid.h>
+#include <linux/input.h>
+#include <linux/math64.h>
+#include <linux/version.h>
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 12, 0)
+#include <linux/unaligned.h>
+#else
+#include <asm/unaligned.h>
+#endif
+#else
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <endian.h>
+#include <linux/input-event-codes.h>
+
+typedef uint8_t u8;
+typedef int8_t s8;
+typedef uint16_t u16;
+typedef int16_t s16;
+typedef uint32_t u32;
+typedef int32_t s32;
+typedef uint64_t u64;
+typedef int64_t s64;
+
+#define __ffs(x) ((unsigned long)__builtin_ctzl(x))
+#define div64_u64(a, b) ((u64)(a) / (u64)(b))
+#define div64_s64(a, b) ((s64)(a) / (s64)(b))
+#define S32_MAX INT32_MAX
+
+static inline u32 get_unaligned_le32(const void *p) {
+	u32 v;
+
+	memcpy(&v, p, sizeof(v));
+	return le32toh(v);
+}
+
+static inline u16 get_unaligned_le16(const void *p) {
+	u16 v;
+
+	memcpy(&v, p, sizeof(v));
+	return le16toh(v);
+}
+
+/* report applications dispatched by the driver, from linux/hid.h */
+#define HID_GD_MOUSE 0x00010002
+#define HID_GD_GAMEPAD 0x00010005
+#define HID_GD_KEYBOARD 0x00010006
+#endif
+
+#define ASUS_MOUSE_KEYS_BITMASK_EVENT_SIZE 17
+
+#define ASUS_MOUSE_MOUSE_WHEEL_RES 120  /* generic mouse wheel resolution */
+
+#define ASUS_MOUSE_DATA_KEY_STATE_BITS 32  /* size of "key_state" item in bits */
+#define ASUS_MOUSE_DATA_KEY_STATE_NUM 4  /* number of "key_state" items */
+
+#define ASUS_MOUSE_MAPPING_SIZE 98
+
+/* emulated wheel speeds are given in hi-res units per base period */
+#define ASUS_MOUSE_SCROLL_BASE_US 16000
+
+#define ASUS_MOUSE_CURVE_SIZE 128  /* entries of a precomputed curve */
+#define ASUS_MOUSE_CURVE_POINTS_MAX 8
+#define ASUS_MOUSE_CURVE_X_MAX 60000
+#define ASUS_MOUSE_CURVE_Y_MAX 1200  /* ten wheel notches per base period */
+
+#define ASUS_MOUSE_JOYSTICK_OFFSET_MAX 127
+#define ASUS_MOUSE_JOYSTICK_FILTER_MAX 7
+#define ASUS_MOUSE_KINETIC_FRICTION_MAX 100  /* percent */
+#define ASUS_MOUSE_KINETIC_GAIN_MAX 1000  /* percent */
+#define ASUS_MOUSE_KINETIC_STEP_MIN 4096  /* 1/16 hi-res unit per tick */
+
+/* driver private event types, placed above EV_MAX so they never reach the input core */
+#define ASUS_MOUSE_EV_WHEEL_KEY (EV_MAX + 1)  /* code: keypad key, value: 1 start, 0 stop */
+#define ASUS_MOUSE_EV_JOYSTICK (EV_MAX + 2)  /* code: ABS_X or ABS_Y, value: offset */
+
+struct asus_mouse_event {
+	u16 type;
+	u16 code;
+	s32 value;
+};
+
+/* worst case is a bitmask report toggling every mapped key */
+#define ASUS_MOUSE_EVENTS_MAX (ASUS_MOUSE_MAPPING_SIZE + 16)
+struct asus_mouse_events {
+	unsigned int count;
+	struct asus_mouse_event ev[ASUS_MOUSE_EVENTS_MAX];
+};
+
+static inline void asus_mouse_events_push(
+		struct asus_mouse_events *evs, u16 type, u16 code, s32 value) {
+	struct asus_mouse_event *ev;
+
+	if (evs->count >= ASUS_MOUSE_EVENTS_MAX)
+		return;
+
+	ev = &evs->ev[evs->count++];
+	ev->type = type;
+	ev->code = code;
+	ev->value = value;
+}
+
+static inline bool asus_mouse_is_wheel_key(unsigned int key_code) {
+	switch(key_code) {
+	case KEY_KP4:
+	case KEY_KP6:
+	case KEY_KP2:
+	case KEY_KP8:
+		return true;
+	default:
+		return false;
+	}
+}
+
+/* capabilities of a product, they select the decoders of its reports */
+#define ASUS_MOUSE_CAP_JOYSTICK (1 << 0)  /* analog stick on a gamepad interface */
+#define ASUS_MOUSE_CAP_SIDE_BUTTONS (1 << 1)  /* forward and back buttons */
+
+/* decoder state of one interface */
+struct asus_mouse_decoder {
+	unsigned int caps;
+	const unsigned short *keymap;  /* by ASUS key code */
+	u32 key_state[ASUS_MOUSE_DATA_KEY_STATE_NUM];
+	u8 buttons;  /* mouse buttons held, by their bit in the report */
+};
+
+typedef void (*asus_mouse_decode_t)(
+		struct asus_mouse_decoder *dec, const u8 *data, struct asus_mouse_events *evs);
+
+/* by their bit in mouse reports */
+static const unsigned short asus_mouse_buttons[] = {
+	BTN_LEFT, BTN_RIGHT, BTN_MIDDLE, BTN_FORWARD, BTN_BACK,
+};
+
+/* mouse reports repeat held buttons, only their edges are sent */
+static inline void asus_mouse_push_mouse(
+		struct asus_mouse_decoder *dec, struct asus_mouse_events *evs,
+		u8 btn, s16 x, s16 y, s8 whl) {
+	unsigned int bit;
+	u8 changed;
+
+	btn &= dec->caps & ASUS_MOUSE_CAP_SIDE_BUTTONS ? 0x1f : 0x07;
+	changed = btn ^ dec->buttons;
+	dec->buttons = btn;
+	for (; changed; changed &= changed - 1) {
+		bit = __ffs(changed);
+		asus_mouse_events_push(evs, EV_KEY, asus_mouse_buttons[bit], (btn >> bit) & 1);
+	}
+
+	asus_mouse_events_push(evs, EV_REL, REL_X, x);
+	asus_mouse_events_push(evs, EV_REL, REL_Y, y);
+	asus_mouse_events_push(evs, EV_REL, REL_WHEEL_HI_RES, whl * ASUS_MOUSE_MOUSE_WHEEL_RES);
+	asus_mouse_events_push(evs, EV_SYN, SYN_REPORT, 0);
+}
+
+/* buttons at 0, X and Y at 1, wheel at 5 */
+static inline void asus_mouse_decode_mouse6(
+		struct asus_mouse_decoder *dec, const u8 *data, struct asus_mouse_events *evs) {
+	asus_mouse_push_mouse(dec, evs, data[0],
+		get_unaligned_le16(data + 1), get_unaligned_le16(data + 3), data[5]);
+}
+
+/* X and Y at 1, buttons at 5, wheel at 6 */
+static inline void asus_mouse_decode_mouse7(
+		struct asus_mouse_decoder *dec, const u8 *data, struct asus_mouse_events *evs) {
+	asus_mouse_push_mouse(dec, evs, data[5],
+		get_unaligned_le16(data + 1), get_unaligned_le16(data + 3), data[6]);
+}
+
+/* X and Y at 0, buttons at 4, wheel at 5 */
+static inline void asus_mouse_decode_mouse11(
+		struct asus_mouse_decoder *dec, const u8 *data, struct asus_mouse_events *evs) {
+	asus_mouse_push_mouse(dec, evs, data[4],
+		get_unaligned_le16(data + 0), get_unaligned_le16(data + 2), data[5]);
+}
+
+/*
+ * Bitmask reports carry a little-endian bitmap of key codes 0...119 after two
+ * header bytes. "key_state" keeps the highest codes in its first item, so the
+ * payload is loaded word by word from the end, the first item getting only
+ * the three bytes left over.
+ */
+static inline void asus_mouse_unpack_bitmask(const u8 *data, u32 *bitmask) {
+	bitmask[3] = get_unaligned_le32(data + 2);
+	bitmask[2] = get_unaligned_le32(data + 6);
+	bitmask[1] = get_unaligned_le32(data + 10);
+	bitmask[0] = get_unaligned_le16(data + 14) | (u32)data[16] << 16;
+}
+
+/* builds a bitmask from an array of active key codes starting at "offset" */
+static inline void asus_mouse_unpack_array(const u8 *data, int offset, int size, u32 *bitmask) {
+	int i, code;
+
+	for (i = 0; i < ASUS_MOUSE_DATA_KEY_STATE_NUM; i++)
+		bitmask[i] = 0;
+
+	for (; offset < size; offset++) {
+		code = data[offset];
+		if (!code)
+			continue;
+		i = ASUS_MOUSE_DATA_KEY_STATE_NUM - (code / ASUS_MOUSE_DATA_KEY_STATE_BITS) - 1;
+		bitmask[i] |= 1u << (code % ASUS_MOUSE_DATA_KEY_STATE_BITS);
+	}
+}
+
+/*
+ * Compares a bitmask of pressed keys against "key_state", which is updated
+ * in place, and emits events for the changed keys only.
+ */
+static inline void asus_mouse_push_keys(
+		struct asus_mouse_decoder *dec, const u32 *bitmask, struct asus_mouse_events *evs) {
+	u32 *key_state = dec->key_state;
+	int i, bit, asus_code, key_code;
+	u32 modified;
+	bool pressed, changed = false;
+
+	for (i = 0; i < ASUS_MOUSE_DATA_KEY_STATE_NUM; i++) {
+		modified = key_state[ASUS_MOUSE_DATA_KEY_STATE_NUM - i - 1] ^
+			bitmask[ASUS_MOUSE_DATA_KEY_STATE_NUM - i - 1];
+		for (; modified; modified &= modified - 1) {
+			bit = __ffs(modified);
+
+			asus_code = i * ASUS_MOUSE_DATA_KEY_STATE_BITS + bit;
+			if (asus_code >= ASUS_MOUSE_MAPPING_SIZE)
+				break;
+
+			key_code = dec->keymap[asus_code];
+			pressed = (bitmask[ASUS_MOUSE_DATA_KEY_STATE_NUM - i - 1] & (1u << bit)) != 0;
+
+			if (asus_mouse_is_wheel_key(key_code)) {
+				/* start or stop repeating wheel events */
+				asus_mouse_events_push(evs, ASUS_MOUSE_EV_WHEEL_KEY, key_code, pressed);
+			} else {
+				/* send regular key event */
+				asus_mouse_events_push(evs, EV_KEY, key_code, pressed);
+			}
+			changed = true;
+		}
+	}
+
+	/* all the changes of one report make one frame */
+	if (changed)
+		asus_mouse_events_push(evs, EV_SYN, SYN_REPORT, 0);
+
+	/* save current keys state for tracking released keys */
+
+	for (i = 0; i < ASUS_MOUSE_DATA_KEY_STATE_NUM; i++)
+		key_state[i] = bitmask[i];
+}
+
+/* key codes from 2 on */
+static inline void asus_mouse_decode_keyboard8(
+		struct asus_mouse_decoder *dec, const u8 *data, struct asus_mouse_events *evs) {
+	u32 bitmask[ASUS_MOUSE_DATA_KEY_STATE_NUM];
+
+	asus_mouse_unpack_array(data, 2, 8, bitmask);
+	asus_mouse_push_keys(dec, bitmask, evs);
+}
+
+/* key codes from 3 on */
+static inline void asus_mouse_decode_keyboard9(
+		struct asus_mouse_decoder *dec, const u8 *data, struct asus_mouse_events *evs) {
+	u32 bitmask[ASUS_MOUSE_DATA_KEY_STATE_NUM];
+
+	asus_mouse_unpack_array(data, 3, 9, bitmask);
+	asus_mouse_push_keys(dec, bitmask, evs);
+}
+
+/* key codes from 3 on */
+static inline void asus_mouse_decode_keyboard12(
+		struct asus_mouse_decoder *dec, const u8 *data, struct asus_mouse_events *evs) {
+	u32 bitmask[ASUS_MOUSE_DATA_KEY_STATE_NUM];
+
+	asus_mouse_unpack_array(data, 3, 12, bitmask);
+	asus_mouse_push_keys(dec, bitmask, evs);
+}
+
+static inline void asus_mouse_decode_keyboard_bitmask(
+		struct asus_mouse_decoder *dec, const u8 *data, struct asus_mouse_events *evs) {
+	u32 bitmask[ASUS_MOUSE_DATA_KEY_STATE_NUM];
+
+	asus_mouse_unpack_bitmask(data, bitmask);
+	asus_mouse_push_keys(dec, bitmask, evs);
+}
+
+/* 0...255 -> -128...127 */
+static inline void asus_mouse_push_joystick(struct asus_mouse_events *evs, u8 x, u8 y) {
+	asus_mouse_events_push(evs, ASUS_MOUSE_EV_JOYSTICK, ABS_X, x - 128);
+	asus_mouse_events_push(evs, ASUS_MOUSE_EV_JOYSTICK, ABS_Y, y - 128);
+}
+
+/* X and Y at 0 */
+static inline void asus_mouse_decode_joystick4(
+		struct asus_mouse_decoder *dec, const u8 *data, struct asus_mouse_events *evs) {
+	asus_mouse_push_joystick(evs, data[0], data[1]);
+}
+
+/* X and Y at 1 */
+static inline void asus_mouse_decode_joystick5(
+		struct asus_mouse_decoder *dec, const u8 *data, struct asus_mouse_events *evs) {
+	asus_mouse_push_joystick(evs, data[1], data[2]);
+}
+
+/* report layouts the driver knows, by the application of their collection and length */
+struct asus_mouse_layout {
+	unsigned int application;
+	int size;
+	unsigned int caps;  /* needed to decode it */
+	asus_mouse_decode_t decode;
+};
+
+static const struct asus_mouse_layout asus_mouse_layouts[] = {
+	{ HID_GD_MOUSE, 6, 0, asus_mouse_decode_mouse6 },
+	{ HID_GD_MOUSE, 7, 0, asus_mouse_decode_mouse7 },
+	{ HID_GD_MOUSE, 11, 0, asus_mouse_decode_mouse11 },
+	{ HID_GD_KEYBOARD, 8, 0, asus_mouse_decode_keyboard8 },
+	{ HID_GD_KEYBOARD, 9, 0, asus_mouse_decode_keyboard9 },
+	{ HID_GD_KEYBOARD, 12, 0, asus_mouse_decode_keyboard12 },
+	{ HID_GD_KEYBOARD, ASUS_MOUSE_KEYS_BITMASK_EVENT_SIZE, 0, asus_mouse_decode_keyboard_bitmask },
+	{ HID_GD_GAMEPAD, 4, ASUS_MOUSE_CAP_JOYSTICK, asus_mouse_decode_joystick4 },
+	{ HID_GD_GAMEPAD, 5, ASUS_MOUSE_CAP_JOYSTICK, asus_mouse_decode_joystick5 },
+};
+
+static inline bool asus_mouse_decodes_application(unsigned int application) {
+	unsigned int i;
+
+	for (i = 0; i < sizeof(asus_mouse_layouts) / sizeof(asus_mouse_layouts[0]); i++)
+		if (asus_mouse_layouts[i].application == application)
+			return true;
+
+	return false;
+}
+
+/* Returns NULL for layouts the driver doesn't know or the product can't send. */
+static inline const struct asus_mouse_layout *asus_mouse_find_layout(
+		unsigned int application, int size, unsigned int caps) {
+	const struct asus_mouse_layout *layout;
+	unsigned int i;
+
+	for (i = 0; i < sizeof(asus_mouse_layouts) / sizeof(asus_mouse_layouts[0]); i++) {
+		layout = &asus_mouse_layouts[i];
+		if (layout->application == application && layout->size == size &&
+				(layout->caps & caps) == layout->caps)
+			return layout;
+	}
+
+	return NULL;
+}
+
+/*
+ * Emulated wheel curves. A curve maps an input, the time in ms a wheel key is
+ * held or the joystick offset, to a speed in hi-res units per base period,
+ * through up to 8 points. Linear and custom curves interpolate linearly between
+ * the points, exponential ones grow geometrically from one point to the next.
+ *
+ * Curves are rebuilt into tables of per-tick steps whenever they or the tick
+ * change, so the timer only has to index a table.
+ */
+enum asus_mouse_curve_type {
+	ASUS_MOUSE_CURVE_LINEAR,
+	ASUS_MOUSE_CURVE_EXP,
+	ASUS_MOUSE_CURVE_CUSTOM,
+};
+
+struct asus_mouse_curve {
+	enum asus_mouse_curve_type type;
+	unsigned int points;
+	u32 x[ASUS_MOUSE_CURVE_POINTS_MAX];  /* strictly increasing */
+	u32 y[ASUS_MOUSE_CURVE_POINTS_MAX];
+};
+
+struct asus_mouse_curve_lut {
+	unsigned int shift;  /* table index is the tick number shifted right by this */
+	u32 step[ASUS_MOUSE_CURVE_SIZE];  /* hi-res units per tick, 16.16 */
+};
+
+/* log2 of a 16.16 number >= 1.0, in 16.16 */
+static inline u32 asus_mouse_log2_fp(u64 x) {
+	u32 result = 0;
+	int i;
+
+	while (x >= (2ull << 16)) {
+		x >>= 1;
+		result += 1 << 16;
+	}
+
+	for (i = 15; i >= 0; i--) {
+		x = (x * x) >> 16;
+		if (x >= (2ull << 16)) {
+			x >>= 1;
+			result |= 1 << i;
+		}
+	}
+
+	return result;
+}
+
+/* 2 to the power of a 16.16 number, in 16.16 */
+static inline u64 asus_mouse_exp2_fp(u32 x) {
+	u64 f = x & 0xffff;
+
+	/* 2^f ~ 1 + f * (0.6563 + 0.3437 * f) on [0, 1), within 0.3% */
+	f = (1 << 16) + ((f * (43012 + ((22524 * f) >> 16))) >> 16);
+	return f << (x >> 16);
+}
+
+/* speed at "x1000" thousandths of the curve input, in 16.16 */
+static inline u64 asus_mouse_curve_eval(const struct asus_mouse_curve *curve, u64 x1000) {
+	const u32 *t = curve->x;
+	const u32 *r = curve->y;
+	unsigned int i, last = curve->points - 1;
+	u64 dt, f, lo, hi;
+
+	if (x1000 <= t[0] * 1000ull)
+		return (u64)r[0] << 16;
+
+	for (i = 1; i < last && x1000 >= t[i] * 1000ull; i++)
+		;
+
+	if (x1000 >= t[i] * 1000ull)
+		return (u64)r[last] << 16;
+
+	dt = (t[i] - t[i - 1]) * 1000ull;
+	f = div64_u64((x1000 - t[i - 1] * 1000ull) << 16, dt);  /* 0...1 in 16.16 */
+
+	if (curve->type == ASUS_MOUSE_CURVE_EXP) {
+		lo = r[i - 1] ? r[i - 1] : 1;
+		hi = r[i] ? r[i] : 1;
+		if (hi >= lo)
+			return lo * asus_mouse_exp2_fp((f * asus_mouse_log2_fp(div64_u64(hi << 16, lo))) >> 16);
+		return div64_u64(lo << 32, asus_mouse_exp2_fp((f * asus_mouse_log2_fp(div64_u64(lo << 16, hi))) >> 16));
+	}
+
+	if (r[i] >= r[i - 1])
+		return ((u64)r[i - 1] << 16) + (r[i] - r[i - 1]) * f;
+	return ((u64)r[i - 1] << 16) - (r[i - 1] - r[i]) * f;
+}
+
+/* builds the table of a curve over time in ms */
+static inline void asus_mouse_curve_build(
+		const struct asus_mouse_curve *curve, unsigned int tick_us, struct asus_mouse_curve_lut *lut) {
+	u64 ticks = div64_u64(curve->x[curve->points - 1] * 1000ull, tick_us);
+	u64 scale = div64_u64((u64)tick_us << 16, ASUS_MOUSE_SCROLL_BASE_US);
+	unsigned int i;
+
+	/* stretch the table over the whole curve, the last entry holds the final speed */
+	lut->shift = 0;
+	while ((ticks >> lut->shift) >= ASUS_MOUSE_CURVE_SIZE - 1)
+		lut->shift++;
+
+	for (i = 0; i < ASUS_MOUSE_CURVE_SIZE; i++)
+		lut->step[i] = (asus_mouse_curve_eval(curve, ((u64)i << lut->shift) * tick_us) * scale) >> 16;
+}
+
+static inline u32 asus_mouse_curve_step(const struct asus_mouse_curve_lut *lut, unsigned int tick) {
+	tick >>= lut->shift;
+	return lut->step[tick < ASUS_MOUSE_CURVE_SIZE ? tick : ASUS_MOUSE_CURVE_SIZE - 1];
+}
+
+/*
+ * Joystick scrolling: reports are centered and cut by "deadzone", then every
+ * scroll tick moves the filtered offset towards the reported one by an
+ * exponential moving average of strength "filter" (new = old + (raw - old) /
+ * 2^filter), so it settles on a stick held still however rarely it reports.
+ * The offset indexes a table of per-tick steps built from "curve", which maps
+ * the stick offset 0...127 to a speed.
+ */
+struct asus_mouse_joystick {
+	unsigned int deadzone;
+	unsigned int filter;
+	struct asus_mouse_curve curve;
+	u32 step[ASUS_MOUSE_JOYSTICK_OFFSET_MAX + 1];  /* hi-res units per tick, 16.16 */
+	s32 target[2];  /* reported X and Y offsets, 24.8 */
+	s32 pos[2];  /* filtered X and Y offsets, 24.8 */
+};
+
+static inline void asus_mouse_joystick_build(struct asus_mouse_joystick *js, unsigned int tick_us) {
+	u64 scale = div64_u64((u64)tick_us << 16, ASUS_MOUSE_SCROLL_BASE_US);
+	unsigned int i;
+
+	for (i = 0; i <= ASUS_MOUSE_JOYSTICK_OFFSET_MAX; i++)
+		js->step[i] = (asus_mouse_curve_eval(&js->curve, i * 1000ull) * scale) >> 16;
+}
+
+/* feeds a centered -128...127 offset of one axis in, the scroll ticks filter it */
+static inline void asus_mouse_joystick_input(struct asus_mouse_joystick *js, unsigned int axis, int raw) {
+	/* back in the deadzone means stopped, whatever the filter says */
+	if (raw > -(int)js->deadzone && raw < (int)js->deadzone) {
+		js->target[axis] = 0;
+		js->pos[axis] = 0;
+		return;
+	}
+
+	js->target[axis] = raw * 256;
+}
+
+/* moves the filtered offsets one tick towards the reported ones */
+static inline void asus_mouse_joystick_tick(struct asus_mouse_joystick *js) {
+	s32 delta, round = (1 << js->filter) - 1;
+	unsigned int axis;
+
+	/* round the correction away from zero so the filter settles on the raw offset */
+	for (axis = 0; axis < 2; axis++) {
+		delta = js->target[axis] - js->pos[axis];
+		if (delta >= 0)
+			js->pos[axis] += (delta + round) >> js->filter;
+		else
+			js->pos[axis] -= (round - delta) >> js->filter;
+	}
+}
+
+static inline bool asus_mouse_joystick_active(const struct asus_mouse_joystick *js) {
+	return js->target[0] || js->target[1] || js->pos[0] || js->pos[1];
+}
+
+/* speed of one axis for one tick, in 16.16 hi-res units */
+static inline s32 asus_mouse_joystick_step(const struct asus_mouse_joystick *js, unsigned int axis) {
+	s32 pos = js->pos[axis];
+	s32 offset = (pos < 0 ? -pos : pos) >> 8;
+
+	if (offset < (s32)js->deadzone)
+		return 0;
+	if (offset > ASUS_MOUSE_JOYSTICK_OFFSET_MAX)
+		offset = ASUS_MOUSE_JOYSTICK_OFFSET_MAX;
+
+	return pos < 0 ? -(s32)js->step[offset] : (s32)js->step[offset];
+}
+
+/*
+ * Kinetic scrolling: wheel motion isn't reported at once but added to a glide,
+ * scaled by "gain" percent. Every base period "friction" percent of what is
+ * left of the glide is emitted, so the speed decays geometrically and the
+ * glide emits exactly the scaled wheel motion. Turning the wheel the other way
+ * drops the glide.
+ */
+struct asus_mouse_kinetic {
+	unsigned int gain;
+	unsigned int friction;
+	u32 rate;  /* share of the glide emitted per tick, 0.16 */
+	s32 rest;  /* glide left, 16.16 hi-res units */
+};
+
+static inline void asus_mouse_kinetic_build(struct asus_mouse_kinetic *kin, unsigned int tick_us) {
+	u64 keep;
+
+	if (kin->friction >= ASUS_MOUSE_KINETIC_FRICTION_MAX) {
+		kin->rate = 1 << 16;
+		return;
+	}
+
+	/* 1 - (1 - friction) ^ (tick / base) */
+	keep = asus_mouse_log2_fp(div64_u64(100ull << 16, 100 - kin->friction));
+	keep = asus_mouse_exp2_fp(div64_u64(keep * tick_us, ASUS_MOUSE_SCROLL_BASE_US));
+	kin->rate = (1 << 16) - div64_u64(1ull << 32, keep);
+	if (!kin->rate)
+		kin->rate = 1;
+}
+
+/* adds "value" hi-res units of wheel motion to the glide */
+static inline void asus_mouse_kinetic_push(struct asus_mouse_kinetic *kin, int value) {
+	s64 rest = kin->rest;
+
+	if ((rest < 0 && value > 0) || (rest > 0 && value < 0))
+		rest = 0;
+
+	rest += div64_s64((s64)value * kin->gain * 65536, 100);
+	if (rest > S32_MAX)
+		rest = S32_MAX;
+	else if (rest < -S32_MAX)
+		rest = -S32_MAX;
+	kin->rest = rest;
+}
+
+static inline bool asus_mouse_kinetic_active(const struct asus_mouse_kinetic *kin) {
+	return kin->rest;
+}
+
+/* takes the motion of one tick off the glide, in 16.16 hi-res units */
+static inline s32 asus_mouse_kinetic_step(struct asus_mouse_kinetic *kin) {
+	s32 rest = kin->rest < 0 ? -kin->rest : kin->rest;
+	s32 step = ((s64)rest * kin->rate) >> 16;
+
+	/* the tail crawls at a minimal speed instead of decaying forever */
+	if (step < ASUS_MOUSE_KINETIC_STEP_MIN)
+		step = rest < ASUS_MOUSE_KINETIC_STEP_MIN ? rest : ASUS_MOUSE_KINETIC_STEP_MIN;
+	if (kin->rest < 0)
+		step = -step;
+
+	kin->rest -= step;
+	return step;
+}
+
+/*
+ * Pointer motion: the motion of every report is multiplied by "scale" percent
+ * and by the gain in percent "curve" gives for its speed, the length of the
+ * motion in counts per report approximated by max + min / 2. Both are folded
+ * into one 16.16 factor per speed whenever they change, so a report costs a
+ * table lookup and two multiplications. Fractions of a count are carried per
+ * axis, so slow motion adds up and long strokes lose nothing.
+ */
+#define ASUS_MOUSE_POINTER_SPEED_MAX 127  /* faster reports get the gain of this speed */
+#define ASUS_MOUSE_POINTER_SCALE_MAX 1000  /* percent */
+
+struct asus_mouse_pointer {
+	unsigned int scale;
+	struct asus_mouse_curve curve;
+	bool active;  /* some factor isn't 1 */
+	u32 factor[ASUS_MOUSE_POINTER_SPEED_MAX + 1];  /* 16.16 */
+	s32 rest[2];  /* fractions of X and Y not sent yet, 0.16 */
+};
+
+static inline void asus_mouse_pointer_build(struct asus_mouse_pointer *ptr) {
+	unsigned int i;
+
+	ptr->active = false;
+	for (i = 0; i <= ASUS_MOUSE_POINTER_SPEED_MAX; i++) {
+		ptr->factor[i] = div64_u64(asus_mouse_curve_eval(&ptr->curve, i * 1000ull) * ptr->scale, 10000);
+		if (ptr->factor[i] != 1 << 16)
+			ptr->active = true;
+	}
+	ptr->rest[0] = 0;
+	ptr->rest[1] = 0;
+}
+
+static inline unsigned int asus_mouse_pointer_speed(s32 x, s32 y) {
+	u32 ax = x < 0 ? -x : x;
+	u32 ay = y < 0 ? -y : y;
+	u32 speed = ax > ay ? ax + ay / 2 : ay + ax / 2;
+
+	return speed < ASUS_MOUSE_POINTER_SPEED_MAX ? speed : ASUS_MOUSE_POINTER_SPEED_MAX;
+}
+
+/* scales the motion of one report in place, rounding down and keeping the fractions */
+static inline void asus_mouse_pointer_apply(struct asus_mouse_pointer *ptr, s32 *x, s32 *y) {
+	u32 factor = ptr->factor[asus_mouse_pointer_speed(*x, *y)];
+	s64 vx = (s64)*x * factor + ptr->rest[0];
+	s64 vy = (s64)*y * factor + ptr->rest[1];
+
+	*x = vx >> 16;
+	*y = vy >> 16;
+	ptr->rest[0] = vx & 0xffff;
+	ptr->rest[1] = vy & 0xffff;
+}
+
+/*
+ * Macros replace their trigger key with a sequence of key and relative motion
+ * events. They are uploaded to the "macro" sysfs file one per write, as the
+ * structure below in host byte order cut after its last step. Steps without
+ * a delay go into the frame of the previous step.
+ */
+#define ASUS_MOUSE_MACROS_MAX 8
+#define ASUS_MOUSE_MACRO_STEPS_MAX 64
+#define ASUS_MOUSE_MACRO_DELAY_US_MAX 1000000
+
+struct asus_mouse_macro_step {
+	u16 type;  /* EV_KEY or EV_REL */
+	u16 code;
+	s32 value;
+	u32 delay_us;  /* wait before this step */
+};
+
+struct asus_mouse_macro {
+	u16 trigger;  /* key code, after the keymap */
+	u16 steps;  /* 0 removes the macro of "trigger" */
+	struct asus_mouse_macro_step step[ASUS_MOUSE_MACRO_STEPS_MAX];
+};
+
+/*
+ * Raw report capture ring, exported by the driver through debugfs. The first
+ * page holds the header, records start at "records_offset". Writers reserve
+ * a record by a global index, so the ring keeps the interleaving of all the
+ * interfaces, and overwrite the oldest records once it is full. A record is
+ * valid while its "seq" is its index plus one: "seq" is zeroed before the
+ * record is rewritten and set last, so a reader copying a record checks that
+ * "seq" didn't change meanwhile.
+ */
+#define ASUS_MOUSE_CAPTURE_MAGIC 0x41534d43  /* "CMSA" */
+#define ASUS_MOUSE_CAPTURE_VERSION 1
+#define ASUS_MOUSE_CAPTURE_DATA_MAX 64  /* longer reports are cut, "size" stays real */
+
+struct asus_mouse_capture_header {
+	u32 magic;
+	u32 version;
+	u32 record_size;
+	u32 records;  /* power of two */
+	u32 records_offset;
+	u32 reserved[3];
+};
+
+struct asus_mouse_capture_record {
+	u64 seq;
+	u64 time_ns;  /* CLOCK_MONOTONIC arrival of the report */
+	u32 application;
+	u32 hid;  /* sequence number of the HID device, as in its name "0003:0B05:1A18.0004" */
+	u16 product;
+	u8 id;  /* report ID */
+	u8 reserved;
+	u16 size;
+	u16 reserved2;
+	u8 data[ASUS_MOUSE_CAPTURE_DATA_MAX];
+};
+
+static inline bool asus_mouse_capture_valid(const struct asus_mouse_capture_header *header, size_t len) {
+	return len >= sizeof(*header) &&
+		header->magic == ASUS_MOUSE_CAPTURE_MAGIC &&
+		header->version == ASUS_MOUSE_CAPTURE_VERSION &&
+		header->record_size == sizeof(struct asus_mouse_capture_record) &&
+		header->records && !(header->records & (header->records - 1)) &&
+		header->records_offset + (u64)header->records * header->record_size <= len;
+}
+
+static inline const struct asus_mouse_capture_record *asus_mouse_capture_record(
+		const struct asus_mouse_capture_header *header, u64 index) {
+	const u8 *records = (const u8 *)header + header->records_offset;
+
+	return (const struct asus_mouse_capture_record *)records +
+		(index & (header->records - 1));
+}
+
+/* oldest record still in the ring, "*end" is past the newest one, both equal if it's empty */
+static inline u64 asus_mouse_capture_range(const struct asus_mouse_capture_header *header, u64 *end) {
+	u64 seq, newest = 0;
+	u32 i;
+
+	for (i = 0; i < header->records; i++) {
+		seq = asus_mouse_capture_record(header, i)->seq;
+		if (seq > newest)
+			newest = seq;
+	}
+
+	*end = newest;
+	return newest > header->records ? newest - header->records : 0;
+}
+
+#endif
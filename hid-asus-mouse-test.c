@@ -0,0 +1,1137 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * KUnit tests for the ASUS mouse driver
+ *
+ * Copyright (c) 2022 Kyoken <kyoken@kyoken.ninja>
+ *
+ * Built into the module by "make kunit" and run when the module is loaded,
+ * or by kunit.py with CONFIG_HID_ASUS_MOUSE_KUNIT_TEST in a kernel tree.
+ * Reports go through asus_mouse_raw_event() of made up HID devices, which
+ * have nothing but their input report lists, and the events reaching the
+ * virtual input devices are recorded by an input handler bound to them only.
+ * The tests swap the module's shared input device for their own, they are
+ * meant for a test kernel with no mouse attached.
+ */
+
+#if !IS_ENABLED(CONFIG_KUNIT)
+#error "the KUnit tests need a kernel built with CONFIG_KUNIT"
+#endif
+#if LINUX_VERSION_CODE < KERNEL_VERSION(6, 0, 0)
+#error "the KUnit tests need Linux 6.0 or later, which runs the suites of a module next to its init"
+#endif
+
+#include <kunit/test.h>
+#include <linux/delay.h>
+#include <linux/timex.h>
+#include <linux/trace_events.h>
+
+#define ASUS_MOUSE_TEST_PHYS "hid-asus-mouse/kunit"
+#define ASUS_MOUSE_TEST_EVENTS 512
+#define ASUS_MOUSE_TEST_HIDS 4
+#define ASUS_MOUSE_TEST_TIMED_REPORTS 1000000
+
+struct asus_mouse_test_event {
+	unsigned int type;
+	unsigned int code;
+	int value;
+};
+
+#define ASUS_MOUSE_TEST_SYN { EV_SYN, SYN_REPORT, 0 }
+
+/* events reaching the input devices under test, in arrival order */
+static struct asus_mouse_test_log {
+	spinlock_t lock;
+	bool record;  /* otherwise events are only counted */
+	unsigned int count;
+	unsigned long total;
+	struct asus_mouse_test_event ev[ASUS_MOUSE_TEST_EVENTS];
+	struct input_dev *input[ASUS_MOUSE_TEST_EVENTS];
+} asus_mouse_test_log = {
+	.lock = __SPIN_LOCK_UNLOCKED(asus_mouse_test_log.lock),
+};
+
+struct asus_mouse_test {
+	struct input_dev *input;
+	struct input_dev *saved_input;
+	bool saved_per_device_input;
+	unsigned int hids;
+	struct hid_device *hdev[ASUS_MOUSE_TEST_HIDS];
+	char names[ASUS_MOUSE_TEST_HIDS][16];
+};
+
+static unsigned short asus_mouse_test_keymap[ASUS_MOUSE_MAPPING_SIZE];
+
+static void asus_mouse_test_handler_event(
+		struct input_handle *handle, unsigned int type, unsigned int code, int value) {
+	struct asus_mouse_test_log *log = &asus_mouse_test_log;
+	unsigned long flags;
+
+	spin_lock_irqsave(&log->lock, flags);
+	log->total++;
+	if (log->record && log->count < ASUS_MOUSE_TEST_EVENTS) {
+		log->ev[log->count].type = type;
+		log->ev[log->count].code = code;
+		log->ev[log->count].value = value;
+		log->input[log->count] = handle->dev;
+		log->count++;
+	}
+	spin_unlock_irqrestore(&log->lock, flags);
+}
+
+static bool asus_mouse_test_handler_match(struct input_handler *handler, struct input_dev *dev) {
+	return dev->phys && !strncmp(dev->phys, ASUS_MOUSE_TEST_PHYS, strlen(ASUS_MOUSE_TEST_PHYS));
+}
+
+static int asus_mouse_test_handler_connect(
+		struct input_handler *handler, struct input_dev *dev, const struct input_device_id *id) {
+	struct input_handle *handle;
+	int ret;
+
+	handle = kzalloc(sizeof(*handle), GFP_KERNEL);
+	if (!handle)
+		return -ENOMEM;
+
+	handle->dev = dev;
+	handle->handler = handler;
+	handle->name = "hid-asus-mouse-kunit";
+
+	ret = input_register_handle(handle);
+	if (ret)
+		goto err_free;
+	ret = input_open_device(handle);
+	if (ret)
+		goto err_unregister;
+
+	return 0;
+
+err_unregister:
+	input_unregister_handle(handle);
+err_free:
+	kfree(handle);
+	return ret;
+}
+
+static void asus_mouse_test_handler_disconnect(struct input_handle *handle) {
+	input_close_device(handle);
+	input_unregister_handle(handle);
+	kfree(handle);
+}
+
+static const struct input_device_id asus_mouse_test_handler_ids[] = {
+	{ .driver_info = 1 },  /* any device, "match" picks ours */
+	{ },
+};
+
+static struct input_handler asus_mouse_test_handler = {
+	.event = asus_mouse_test_handler_event,
+	.match = asus_mouse_test_handler_match,
+	.connect = asus_mouse_test_handler_connect,
+	.disconnect = asus_mouse_test_handler_disconnect,
+	.name = "hid-asus-mouse-kunit",
+	.id_table = asus_mouse_test_handler_ids,
+};
+
+static void asus_mouse_test_log_reset(bool record) {
+	unsigned long flags;
+
+	spin_lock_irqsave(&asus_mouse_test_log.lock, flags);
+	asus_mouse_test_log.record = record;
+	asus_mouse_test_log.count = 0;
+	asus_mouse_test_log.total = 0;
+	spin_unlock_irqrestore(&asus_mouse_test_log.lock, flags);
+}
+
+/* checks the recorded events against "expected" and forgets them */
+static void asus_mouse_test_expect(
+		struct kunit *test, const struct asus_mouse_test_event *expected, unsigned int count) {
+	struct asus_mouse_test_log *log = &asus_mouse_test_log;
+	unsigned int i;
+
+	KUNIT_EXPECT_EQ(test, log->count, count);
+	for (i = 0; i < min(log->count, count); i++) {
+		KUNIT_EXPECT_EQ_MSG(test, log->ev[i].type, expected[i].type, "event %u", i);
+		KUNIT_EXPECT_EQ_MSG(test, log->ev[i].code, expected[i].code, "event %u", i);
+		KUNIT_EXPECT_EQ_MSG(test, log->ev[i].value, expected[i].value, "event %u", i);
+	}
+	asus_mouse_test_log_reset(true);
+}
+
+#define ASUS_MOUSE_TEST_EXPECT(test, ...) do { \
+	static const struct asus_mouse_test_event __expected[] = { __VA_ARGS__ }; \
+\
+	asus_mouse_test_expect(test, __expected, ARRAY_SIZE(__expected)); \
+} while (0)
+
+#define ASUS_MOUSE_TEST_EXPECT_NONE(test) asus_mouse_test_expect(test, NULL, 0)
+
+static const struct hid_device_id *asus_mouse_test_id(struct kunit *test, u16 product) {
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_SIZE(asus_mouse_devices) - 1; i++)
+		if (asus_mouse_devices[i].product == product)
+			return &asus_mouse_devices[i];
+
+	KUNIT_FAIL(test, "no device ID for product 0x%04x", product);
+	return &asus_mouse_devices[0];
+}
+
+/*
+ * Binds a made up interface of "product" with one unnumbered input report,
+ * its "phys" telling the interfaces of one mouse apart from another mouse.
+ */
+static struct asus_mouse_data *asus_mouse_test_bind(
+		struct kunit *test, u16 product, const char *phys, unsigned int application, int size) {
+	struct asus_mouse_test *t = test->priv;
+	struct asus_mouse_data *drv_data;
+	struct hid_report *report;
+	struct hid_device *hdev;
+	unsigned int i;
+	int ret;
+
+	KUNIT_ASSERT_LT(test, t->hids, ASUS_MOUSE_TEST_HIDS);
+
+	hdev = kunit_kzalloc(test, sizeof(*hdev), GFP_KERNEL);
+	KUNIT_ASSERT_NOT_NULL(test, hdev);
+	report = kunit_kzalloc(test, sizeof(*report), GFP_KERNEL);
+	KUNIT_ASSERT_NOT_NULL(test, report);
+	drv_data = kunit_kzalloc(test, sizeof(*drv_data), GFP_KERNEL);
+	KUNIT_ASSERT_NOT_NULL(test, drv_data);
+	drv_data->stats = alloc_percpu(struct asus_mouse_stats);
+	KUNIT_ASSERT_NOT_NULL(test, drv_data->stats);
+
+	snprintf(t->names[t->hids], sizeof(t->names[t->hids]), "kunit.%u", t->hids);
+	hdev->dev.init_name = t->names[t->hids];
+	hdev->bus = product == USB_DEVICE_ID_ASUSTEK_ROG_CHAKRAM_X_BT ? BUS_BLUETOOTH : BUS_USB;
+	hdev->vendor = USB_VENDOR_ID_ASUSTEK;
+	hdev->product = product;
+	hdev->id = t->hids;
+	strscpy(hdev->phys, phys, sizeof(hdev->phys));
+	for (i = 0; i < HID_REPORT_TYPES; i++)
+		INIT_LIST_HEAD(&hdev->report_enum[i].report_list);
+
+	report->type = HID_INPUT_REPORT;
+	report->application = application;
+	report->size = size * 8;
+	report->device = hdev;
+	list_add_tail(&report->list, &hdev->report_enum[HID_INPUT_REPORT].report_list);
+	hdev->report_enum[HID_INPUT_REPORT].report_id_hash[0] = report;
+
+	ret = asus_mouse_attach(hdev, asus_mouse_test_id(test, product), drv_data);
+	if (ret)
+		free_percpu(drv_data->stats);
+	KUNIT_ASSERT_EQ(test, ret, 0);
+
+	t->hdev[t->hids++] = hdev;
+	return drv_data;
+}
+
+static struct hid_device *asus_mouse_test_hdev(struct kunit *test, unsigned int i) {
+	struct asus_mouse_test *t = test->priv;
+
+	return t->hdev[i];
+}
+
+/* one report of "size" bytes through the driver, the way hid-core hands it over */
+static void asus_mouse_test_send(struct hid_device *hdev, const u8 *data, int size) {
+	u8 buf[ASUS_MOUSE_KEYS_BITMASK_EVENT_SIZE];
+
+	memcpy(buf, data, min_t(int, size, sizeof(buf)));
+	asus_mouse_raw_event(hdev, hdev->report_enum[HID_INPUT_REPORT].report_id_hash[0], buf, size);
+}
+
+static unsigned long asus_mouse_test_stat(struct asus_mouse_stats __percpu *stats, size_t offset) {
+	return asus_mouse_stats_sum(stats, offset);
+}
+
+#define ASUS_MOUSE_TEST_STAT(stats, name) \
+	asus_mouse_test_stat(stats, offsetof(struct asus_mouse_stats, name))
+
+/* the timestamp waiting for the next sync, read away from a running scroll tick */
+static s64 asus_mouse_test_stamp(struct asus_mouse_data *drv_data) {
+	struct asus_mouse_device *device = drv_data->device;
+	unsigned long flags;
+	ktime_t stamp;
+
+	spin_lock_irqsave(&device->lock, flags);
+	stamp = drv_data->input->timestamp[INPUT_CLK_MONO];
+	spin_unlock_irqrestore(&device->lock, flags);
+	return ktime_to_ns(stamp);
+}
+
+static int asus_mouse_test_init(struct kunit *test) {
+	struct asus_mouse_test *t;
+	struct input_dev *input;
+	int ret;
+
+	t = kunit_kzalloc(test, sizeof(*t), GFP_KERNEL);
+	if (!t)
+		return -ENOMEM;
+	test->priv = t;
+
+	input = asus_mouse_input_create(ASUS_MOUSE_TEST_PHYS, NULL, NULL, asus_mouse_test_keymap);
+	if (IS_ERR(input))
+		return PTR_ERR(input);
+
+	ret = input_register_handler(&asus_mouse_test_handler);
+	if (ret) {
+		input_unregister_device(input);
+		return ret;
+	}
+
+	t->input = input;
+	t->saved_input = asus_mouse_input;
+	t->saved_per_device_input = per_device_input;
+	asus_mouse_input = input;
+	per_device_input = false;
+	asus_mouse_test_log_reset(true);
+
+	return 0;
+}
+
+static void asus_mouse_test_exit(struct kunit *test) {
+	struct asus_mouse_test *t = test->priv;
+	struct asus_mouse_data *drv_data;
+	unsigned int i;
+
+	/* KUnit calls this after a failed init too */
+	if (!t || !t->input)
+		return;
+
+	for (i = 0; i < t->hids; i++) {
+		drv_data = hid_get_drvdata(t->hdev[i]);
+		hid_set_drvdata(t->hdev[i], NULL);
+		asus_mouse_device_put(drv_data->device);
+		free_percpu(drv_data->stats);
+	}
+
+	input_unregister_handler(&asus_mouse_test_handler);
+	input_unregister_device(t->input);
+	asus_mouse_input = t->saved_input;
+	per_device_input = t->saved_per_device_input;
+}
+
+/* buttons at 0, X and Y at 1, wheel at 5 */
+static void asus_mouse_test_mouse6(struct kunit *test) {
+	static const u8 press[] = { 0x01, 0x05, 0x00, 0xfd, 0xff, 0x01 };
+	static const u8 hold[] = { 0x01, 0x02, 0x00, 0x00, 0x00, 0x00 };
+	static const u8 release[] = { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 };
+	struct hid_device *hdev;
+
+	asus_mouse_test_bind(test, USB_DEVICE_ID_ASUSTEK_ROG_CHAKRAM_X_USB,
+		"kunit-0/input0", HID_GD_MOUSE, 6);
+	hdev = asus_mouse_test_hdev(test, 0);
+
+	asus_mouse_test_send(hdev, press, sizeof(press));
+	ASUS_MOUSE_TEST_EXPECT(test,
+		{ EV_KEY, BTN_LEFT, 1 },
+		{ EV_REL, REL_X, 5 },
+		{ EV_REL, REL_Y, -3 },
+		{ EV_REL, REL_WHEEL_HI_RES, ASUS_MOUSE_MOUSE_WHEEL_RES },
+		ASUS_MOUSE_TEST_SYN);
+
+	/* a held button isn't pressed again */
+	asus_mouse_test_send(hdev, hold, sizeof(hold));
+	ASUS_MOUSE_TEST_EXPECT(test,
+		{ EV_REL, REL_X, 2 },
+		ASUS_MOUSE_TEST_SYN);
+
+	asus_mouse_test_send(hdev, release, sizeof(release));
+	ASUS_MOUSE_TEST_EXPECT(test,
+		{ EV_KEY, BTN_LEFT, 0 },
+		ASUS_MOUSE_TEST_SYN);
+}
+
+/* X and Y at 1, buttons at 5, wheel at 6 */
+static void asus_mouse_test_mouse7(struct kunit *test) {
+	static const u8 press[] = { 0x00, 0xff, 0xff, 0x10, 0x00, 0x18, 0xff };
+	static const u8 release[] = { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 };
+	struct hid_device *hdev;
+
+	asus_mouse_test_bind(test, USB_DEVICE_ID_ASUSTEK_ROG_CHAKRAM_X_USB,
+		"kunit-0/input0", HID_GD_MOUSE, 7);
+	hdev = asus_mouse_test_hdev(test, 0);
+
+	asus_mouse_test_send(hdev, press, sizeof(press));
+	ASUS_MOUSE_TEST_EXPECT(test,
+		{ EV_KEY, BTN_FORWARD, 1 },
+		{ EV_KEY, BTN_BACK, 1 },
+		{ EV_REL, REL_X, -1 },
+		{ EV_REL, REL_Y, 16 },
+		{ EV_REL, REL_WHEEL_HI_RES, -ASUS_MOUSE_MOUSE_WHEEL_RES },
+		ASUS_MOUSE_TEST_SYN);
+
+	asus_mouse_test_send(hdev, release, sizeof(release));
+	ASUS_MOUSE_TEST_EXPECT(test,
+		{ EV_KEY, BTN_FORWARD, 0 },
+		{ EV_KEY, BTN_BACK, 0 },
+		ASUS_MOUSE_TEST_SYN);
+}
+
+/* X and Y at 0, buttons at 4, wheel at 5, side buttons only with their capability */
+static void asus_mouse_test_mouse11(struct kunit *test) {
+	static const u8 press[] = { 0x00, 0x01, 0x00, 0x02, 0x1e, 0x00, 0, 0, 0, 0, 0 };
+	static const u8 release[] = { 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0, 0, 0, 0, 0 };
+	struct hid_device *hdev;
+
+	asus_mouse_test_bind(test, USB_DEVICE_ID_ASUSTEK_ROG_STRIX_IMPACT,
+		"kunit-0/input0", HID_GD_MOUSE, 11);
+	hdev = asus_mouse_test_hdev(test, 0);
+
+	asus_mouse_test_send(hdev, press, sizeof(press));
+	ASUS_MOUSE_TEST_EXPECT(test,
+		{ EV_KEY, BTN_RIGHT, 1 },
+		{ EV_KEY, BTN_MIDDLE, 1 },
+		{ EV_REL, REL_X, 256 },
+		{ EV_REL, REL_Y, 512 },
+		ASUS_MOUSE_TEST_SYN);
+
+	asus_mouse_test_send(hdev, release, sizeof(release));
+	ASUS_MOUSE_TEST_EXPECT(test,
+		{ EV_KEY, BTN_RIGHT, 0 },
+		{ EV_KEY, BTN_MIDDLE, 0 },
+		ASUS_MOUSE_TEST_SYN);
+}
+
+/* ASUS key code 4 is KEY_A and 5 is KEY_B in every keyboard layout */
+static void asus_mouse_test_keyboard(struct kunit *test, int size) {
+	u8 report[ASUS_MOUSE_KEYS_BITMASK_EVENT_SIZE] = { };
+	struct asus_mouse_test *t = test->priv;
+	int first = size == 8 ? 2 : 3;
+	struct hid_device *hdev;
+
+	asus_mouse_test_bind(test, USB_DEVICE_ID_ASUSTEK_ROG_CHAKRAM_X_USB,
+		"kunit-0/input1", HID_GD_KEYBOARD, size);
+	hdev = asus_mouse_test_hdev(test, 0);
+
+	if (size == ASUS_MOUSE_KEYS_BITMASK_EVENT_SIZE)
+		report[2] = 1 << 4;
+	else
+		report[first] = 4;
+	asus_mouse_test_send(hdev, report, size);
+	ASUS_MOUSE_TEST_EXPECT(test,
+		{ EV_KEY, KEY_A, 1 },
+		ASUS_MOUSE_TEST_SYN);
+
+	/* nothing changed, nothing sent, and no stamp left for the next frame */
+	asus_mouse_test_send(hdev, report, size);
+	ASUS_MOUSE_TEST_EXPECT_NONE(test);
+	KUNIT_EXPECT_EQ(test, ktime_to_ns(t->input->timestamp[INPUT_CLK_MONO]), 0);
+
+	if (size == ASUS_MOUSE_KEYS_BITMASK_EVENT_SIZE)
+		report[2] |= 1 << 5;
+	else
+		report[first + 1] = 5;
+	asus_mouse_test_send(hdev, report, size);
+	ASUS_MOUSE_TEST_EXPECT(test,
+		{ EV_KEY, KEY_B, 1 },
+		ASUS_MOUSE_TEST_SYN);
+
+	memset(report, 0, sizeof(report));
+	asus_mouse_test_send(hdev, report, size);
+	ASUS_MOUSE_TEST_EXPECT(test,
+		{ EV_KEY, KEY_A, 0 },
+		{ EV_KEY, KEY_B, 0 },
+		ASUS_MOUSE_TEST_SYN);
+}
+
+static void asus_mouse_test_keyboard8(struct kunit *test) {
+	asus_mouse_test_keyboard(test, 8);
+}
+
+static void asus_mouse_test_keyboard9(struct kunit *test) {
+	asus_mouse_test_keyboard(test, 9);
+}
+
+static void asus_mouse_test_keyboard12(struct kunit *test) {
+	asus_mouse_test_keyboard(test, 12);
+}
+
+static void asus_mouse_test_keyboard_bitmask(struct kunit *test) {
+	asus_mouse_test_keyboard(test, ASUS_MOUSE_KEYS_BITMASK_EVENT_SIZE);
+}
+
+/* a stick pushed off its center scrolls from the timer until it's back */
+static void asus_mouse_test_gamepad(struct kunit *test, int size) {
+	u8 report[5] = { };
+	int off = size == 5 ? 1 : 0;
+	struct asus_mouse_data *drv_data;
+	struct hid_device *hdev;
+	unsigned int i;
+	int hwheel = 0;
+
+	drv_data = asus_mouse_test_bind(test, USB_DEVICE_ID_ASUSTEK_ROG_CHAKRAM_X_USB,
+		"kunit-0/input2", HID_GD_GAMEPAD, size);
+	hdev = asus_mouse_test_hdev(test, 0);
+
+	/* a centered stick reports nothing, and leaves no stamp for the next frame */
+	report[off] = 128;
+	report[off + 1] = 128;
+	asus_mouse_test_send(hdev, report, size);
+	KUNIT_EXPECT_EQ(test, asus_mouse_test_stamp(drv_data), 0);
+
+	report[off] = 128 + 100;
+	for (i = 0; i < 8; i++) {
+		asus_mouse_test_send(hdev, report, size);
+		KUNIT_EXPECT_EQ_MSG(test, asus_mouse_test_stamp(drv_data), 0, "report %u", i);
+	}
+	KUNIT_EXPECT_TRUE(test, asus_mouse_joystick_active(&drv_data->device->joystick));
+
+	msleep(50);
+
+	/* neither do the reports while it scrolls */
+	report[off] = 128 + 101;
+	asus_mouse_test_send(hdev, report, size);
+	KUNIT_EXPECT_EQ(test, asus_mouse_test_stamp(drv_data), 0);
+
+	report[off] = 128;
+	asus_mouse_test_send(hdev, report, size);
+	KUNIT_EXPECT_FALSE(test, asus_mouse_joystick_active(&drv_data->device->joystick));
+	KUNIT_EXPECT_EQ(test, asus_mouse_test_stamp(drv_data), 0);
+
+	for (i = 0; i < asus_mouse_test_log.count; i++) {
+		KUNIT_EXPECT_NE(test, asus_mouse_test_log.ev[i].code, REL_WHEEL_HI_RES);
+		if (asus_mouse_test_log.ev[i].type == EV_REL &&
+				asus_mouse_test_log.ev[i].code == REL_HWHEEL_HI_RES)
+			hwheel += asus_mouse_test_log.ev[i].value;
+	}
+	KUNIT_EXPECT_GT(test, hwheel, 0);
+}
+
+static void asus_mouse_test_gamepad4(struct kunit *test) {
+	asus_mouse_test_gamepad(test, 4);
+}
+
+static void asus_mouse_test_gamepad5(struct kunit *test) {
+	asus_mouse_test_gamepad(test, 5);
+}
+
+/*
+ * The stick of a Bluetooth mouse with the scroll tick tracepoint on: the
+ * mouse has no USB device above it, the event names it by its own name.
+ */
+static void asus_mouse_test_trace(struct kunit *test) {
+	u8 report[4] = { 128 + 100, 128 };
+	struct asus_mouse_data *drv_data;
+	struct hid_device *hdev;
+	unsigned int i;
+	int ret;
+
+	if (!IS_ENABLED(CONFIG_EVENT_TRACING))
+		kunit_skip(test, "the kernel has no trace events");
+
+	drv_data = asus_mouse_test_bind(test, USB_DEVICE_ID_ASUSTEK_ROG_CHAKRAM_X_BT,
+		"kunit-bt/input0", HID_GD_GAMEPAD, sizeof(report));
+	hdev = asus_mouse_test_hdev(test, 0);
+	KUNIT_EXPECT_PTR_EQ(test, drv_data->device->parent, NULL);
+
+	ret = trace_set_clr_event("asus_mouse", "asus_mouse_scroll_tick", 1);
+	KUNIT_ASSERT_EQ(test, ret, 0);
+
+	for (i = 0; i < 8; i++)
+		asus_mouse_test_send(hdev, report, sizeof(report));
+	msleep(50);
+	report[0] = 128;
+	asus_mouse_test_send(hdev, report, sizeof(report));
+
+	trace_set_clr_event("asus_mouse", "asus_mouse_scroll_tick", 0);
+
+	KUNIT_EXPECT_GT(test, asus_mouse_test_log.count, 0);
+}
+
+/* remapping keeps the base keys advertised, the others follow the keymap */
+static void asus_mouse_test_remap(struct kunit *test) {
+	struct asus_mouse_test *t = test->priv;
+	struct input_keymap_entry ke = {
+		.flags = INPUT_KEYMAP_BY_INDEX,
+		.index = 4,  /* KEY_A */
+		.keycode = KEY_MACRO1,
+	};
+
+	KUNIT_ASSERT_EQ(test, input_set_keycode(t->input, &ke), 0);
+	KUNIT_EXPECT_TRUE(test, test_bit(KEY_MACRO1, t->input->keybit));
+	KUNIT_EXPECT_TRUE(test, test_bit(KEY_A, t->input->keybit));
+	KUNIT_EXPECT_TRUE(test, test_bit(KEY_LEFTCTRL, t->input->keybit));
+
+	ke.keycode = KEY_A;
+	KUNIT_ASSERT_EQ(test, input_set_keycode(t->input, &ke), 0);
+	KUNIT_EXPECT_FALSE(test, test_bit(KEY_MACRO1, t->input->keybit));
+	KUNIT_EXPECT_TRUE(test, test_bit(KEY_A, t->input->keybit));
+}
+
+/*
+ * Macros written through sysfs read back the same, replace their trigger key
+ * and play after its report. A key left pressed by a macro is released in a
+ * frame of its own when it starts again.
+ */
+static void asus_mouse_test_macro(struct kunit *test) {
+	static const struct asus_mouse_macro type = {
+		.trigger = KEY_A,
+		.steps = 4,
+		.step = {
+			{ EV_KEY, KEY_LEFTSHIFT, 1, 0 },
+			{ EV_KEY, KEY_B, 1, 0 },
+			{ EV_KEY, KEY_B, 0, 1000 },
+			{ EV_KEY, KEY_LEFTSHIFT, 0, 0 },
+		},
+	};
+	static const struct asus_mouse_macro hold = {
+		.trigger = KEY_C,
+		.steps = 1,
+		.step = { { EV_KEY, KEY_LEFTCTRL, 1, 0 } },
+	};
+	size_t type_size = offsetof(struct asus_mouse_macro, step[4]);
+	size_t hold_size = offsetof(struct asus_mouse_macro, step[1]);
+	u8 report[8] = { }, *buf;
+	struct hid_device *hdev;
+	unsigned int i;
+
+	asus_mouse_test_bind(test, USB_DEVICE_ID_ASUSTEK_ROG_CHAKRAM_X_USB,
+		"kunit-0/input1", HID_GD_KEYBOARD, sizeof(report));
+	hdev = asus_mouse_test_hdev(test, 0);
+
+	KUNIT_ASSERT_EQ(test, macro_write(NULL, &hdev->dev.kobj, &bin_attr_macro,
+		(char *)&type, 0, type_size), (ssize_t)type_size);
+	KUNIT_ASSERT_EQ(test, macro_write(NULL, &hdev->dev.kobj, &bin_attr_macro,
+		(char *)&hold, 0, hold_size), (ssize_t)hold_size);
+
+	buf = kunit_kzalloc(test, bin_attr_macro.size, GFP_KERNEL);
+	KUNIT_ASSERT_NOT_NULL(test, buf);
+	KUNIT_ASSERT_EQ(test, macro_read(NULL, &hdev->dev.kobj, &bin_attr_macro,
+		(char *)buf, 0, bin_attr_macro.size), (ssize_t)(type_size + hold_size));
+	KUNIT_EXPECT_EQ(test, memcmp(buf, &type, type_size), 0);
+	KUNIT_EXPECT_EQ(test, memcmp(buf + type_size, &hold, hold_size), 0);
+
+	/* the trigger itself is consumed */
+	report[2] = 4;  /* KEY_A */
+	asus_mouse_test_send(hdev, report, sizeof(report));
+	report[2] = 0;
+	asus_mouse_test_send(hdev, report, sizeof(report));
+	msleep(20);
+	ASUS_MOUSE_TEST_EXPECT(test,
+		{ EV_KEY, KEY_LEFTSHIFT, 1 },
+		{ EV_KEY, KEY_B, 1 },
+		ASUS_MOUSE_TEST_SYN,
+		{ EV_KEY, KEY_B, 0 },
+		{ EV_KEY, KEY_LEFTSHIFT, 0 },
+		ASUS_MOUSE_TEST_SYN);
+
+	for (i = 0; i < 2; i++) {
+		report[2] = 6;  /* KEY_C */
+		asus_mouse_test_send(hdev, report, sizeof(report));
+		report[2] = 0;
+		asus_mouse_test_send(hdev, report, sizeof(report));
+		msleep(20);
+	}
+	ASUS_MOUSE_TEST_EXPECT(test,
+		{ EV_KEY, KEY_LEFTCTRL, 1 },
+		ASUS_MOUSE_TEST_SYN,
+		{ EV_KEY, KEY_LEFTCTRL, 0 },
+		ASUS_MOUSE_TEST_SYN,
+		{ EV_KEY, KEY_LEFTCTRL, 1 },
+		ASUS_MOUSE_TEST_SYN);
+}
+
+/* every device ID finds its own profile, with limits the vendor commands can carry */
+static void asus_mouse_test_profiles(struct kunit *test) {
+	const struct asus_mouse_profile *profile;
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_SIZE(asus_mouse_devices) - 1; i++) {
+		profile = asus_mouse_find_profile(&asus_mouse_devices[i]);
+		KUNIT_EXPECT_EQ_MSG(test, (kernel_ulong_t)profile, asus_mouse_devices[i].driver_data,
+			"product 0x%04x", asus_mouse_devices[i].product);
+		KUNIT_EXPECT_LE(test, profile->dpi_stages, ASUS_MOUSE_DPI_STAGES_MAX);
+		KUNIT_EXPECT_LE(test, profile->dpi_max / ASUS_MOUSE_DPI_UNIT - 1, 0xffffu);
+		KUNIT_EXPECT_EQ(test, profile->rates >> ASUS_MOUSE_RATES, 0u);
+	}
+}
+
+/* interfaces share the device of their mouse by "phys" up to the interface number */
+static void asus_mouse_test_grouping(struct kunit *test) {
+	struct asus_mouse_data *mouse, *keyboard, *other;
+
+	mouse = asus_mouse_test_bind(test, USB_DEVICE_ID_ASUSTEK_ROG_CHAKRAM_X_USB,
+		"kunit-0/input0", HID_GD_MOUSE, 7);
+	keyboard = asus_mouse_test_bind(test, USB_DEVICE_ID_ASUSTEK_ROG_CHAKRAM_X_USB,
+		"kunit-0/input1", HID_GD_KEYBOARD, 8);
+	other = asus_mouse_test_bind(test, USB_DEVICE_ID_ASUSTEK_ROG_CHAKRAM_X_USB,
+		"kunit-1/input0", HID_GD_MOUSE, 7);
+
+	KUNIT_EXPECT_PTR_EQ(test, mouse->device, keyboard->device);
+	KUNIT_EXPECT_PTR_NE(test, mouse->device, other->device);
+	KUNIT_EXPECT_STREQ(test, mouse->device->name, "kunit-0");
+	KUNIT_EXPECT_EQ(test, mouse->device->users, 2u);
+}
+
+/*
+ * The RF and USB paths of one mouse: the standby path is suppressed, the path
+ * taking over releases a button held through the other one, and a path
+ * coming back starts over from an empty decoder state. Models sharing a USB
+ * ID are never linked.
+ */
+static void asus_mouse_test_dedup(struct kunit *test) {
+	unsigned int saved_quiet_ms = dedup_quiet_ms;
+	struct asus_mouse_data *rf, *usb, *spatha, *gladius;
+	u8 held[7] = { }, released[7] = { };
+
+	rf = asus_mouse_test_bind(test, USB_DEVICE_ID_ASUSTEK_ROG_CHAKRAM_X_RF,
+		"kunit-rf/input0", HID_GD_MOUSE, sizeof(held));
+	usb = asus_mouse_test_bind(test, USB_DEVICE_ID_ASUSTEK_ROG_CHAKRAM_X_USB,
+		"kunit-usb/input0", HID_GD_MOUSE, sizeof(held));
+	KUNIT_ASSERT_PTR_EQ(test, rcu_access_pointer(rf->device->peer), usb->device);
+
+	/* a Gladius II Origin shares its ID with the Spatha X cable, it's not one */
+	spatha = asus_mouse_test_bind(test, USB_DEVICE_ID_ASUSTEK_ROG_SPATHA_X_RF,
+		"kunit-spatha/input0", HID_GD_MOUSE, sizeof(held));
+	gladius = asus_mouse_test_bind(test, USB_DEVICE_ID_ASUSTEK_ROG_GLADIUS2_ORIGIN,
+		"kunit-gladius/input0", HID_GD_MOUSE, sizeof(held));
+	KUNIT_EXPECT_PTR_EQ(test, rcu_access_pointer(spatha->device->peer), NULL);
+	KUNIT_EXPECT_PTR_EQ(test, rcu_access_pointer(gladius->device->peer), NULL);
+
+	held[5] = 0x01;  /* BTN_LEFT */
+	dedup_quiet_ms = 10;
+
+	asus_mouse_test_send(asus_mouse_test_hdev(test, 0), held, sizeof(held));
+	ASUS_MOUSE_TEST_EXPECT(test,
+		{ EV_KEY, BTN_LEFT, 1 },
+		ASUS_MOUSE_TEST_SYN);
+	asus_mouse_test_send(asus_mouse_test_hdev(test, 1), held, sizeof(held));
+	ASUS_MOUSE_TEST_EXPECT_NONE(test);
+
+	/* released while the paths switched over */
+	msleep(20);
+	asus_mouse_test_send(asus_mouse_test_hdev(test, 1), released, sizeof(released));
+	ASUS_MOUSE_TEST_EXPECT(test,
+		{ EV_KEY, BTN_LEFT, 0 },
+		ASUS_MOUSE_TEST_SYN);
+	asus_mouse_test_send(asus_mouse_test_hdev(test, 1), held, sizeof(held));
+	ASUS_MOUSE_TEST_EXPECT(test,
+		{ EV_KEY, BTN_LEFT, 1 },
+		ASUS_MOUSE_TEST_SYN);
+
+	/* held across the switch back, the RF decoder still had it from before */
+	msleep(20);
+	asus_mouse_test_send(asus_mouse_test_hdev(test, 0), held, sizeof(held));
+	ASUS_MOUSE_TEST_EXPECT(test,
+		{ EV_KEY, BTN_LEFT, 0 },
+		ASUS_MOUSE_TEST_SYN,
+		{ EV_KEY, BTN_LEFT, 1 },
+		ASUS_MOUSE_TEST_SYN);
+	KUNIT_EXPECT_EQ(test, ASUS_MOUSE_TEST_STAT(usb->device->stats, path_switches), 1ul);
+	KUNIT_EXPECT_EQ(test, ASUS_MOUSE_TEST_STAT(rf->device->stats, path_switches), 2ul);
+
+	dedup_quiet_ms = saved_quiet_ms;
+}
+
+/*
+ * Reports of an unknown length are dropped and counted, a known layout of
+ * another length is decoded, as when a HID-BPF program rewrites the reports.
+ */
+static void asus_mouse_test_resize(struct kunit *test) {
+	static const u8 unknown[9] = { 0x01, 0x05 };
+	static const u8 mouse7[] = { 0x00, 0x03, 0x00, 0x00, 0x00, 0x01, 0x00 };
+	struct asus_mouse_data *drv_data;
+	struct hid_device *hdev;
+
+	drv_data = asus_mouse_test_bind(test, USB_DEVICE_ID_ASUSTEK_ROG_CHAKRAM_X_USB,
+		"kunit-0/input0", HID_GD_MOUSE, 6);
+	hdev = asus_mouse_test_hdev(test, 0);
+
+	asus_mouse_test_send(hdev, unknown, sizeof(unknown));
+	ASUS_MOUSE_TEST_EXPECT_NONE(test);
+	KUNIT_EXPECT_EQ(test, ASUS_MOUSE_TEST_STAT(drv_data->stats, dropped), 1);
+
+	asus_mouse_test_send(hdev, mouse7, sizeof(mouse7));
+	ASUS_MOUSE_TEST_EXPECT(test,
+		{ EV_KEY, BTN_LEFT, 1 },
+		{ EV_REL, REL_X, 3 },
+		ASUS_MOUSE_TEST_SYN);
+	KUNIT_EXPECT_EQ(test, drv_data->reports[0].size, 7);
+	KUNIT_EXPECT_EQ(test, ASUS_MOUSE_TEST_STAT(drv_data->stats, dropped), 1);
+}
+
+static u32 asus_mouse_test_rand(u32 *seed) {
+	/* xorshift32, the same reports on every run */
+	*seed ^= *seed << 13;
+	*seed ^= *seed >> 17;
+	*seed ^= *seed << 5;
+	return *seed;
+}
+
+/* byte by byte unpacking of bitmask reports, as the driver used to do it */
+static void asus_mouse_test_unpack_bitmask(const u8 *data, u32 *bitmask) {
+	int i, bit, offset = ASUS_MOUSE_KEYS_BITMASK_EVENT_SIZE - 1;
+
+	for (i = 0; i < ASUS_MOUSE_DATA_KEY_STATE_NUM; i++) {
+		bitmask[i] = 0;
+		bit = 0;
+		if (i == 0)  /* first byte of 16-byte number is missing, so we skip it */
+			bit = 8;
+		for (; bit < ASUS_MOUSE_DATA_KEY_STATE_BITS; bit += 8) {
+			bitmask[i] |= (u32)data[offset] << (ASUS_MOUSE_DATA_KEY_STATE_BITS - 8 - bit);
+			offset--;
+		}
+	}
+}
+
+/* the word-wise bitmask unpacking against the reference, bit for bit */
+static void asus_mouse_test_bitmask(struct kunit *test) {
+	u8 data[ASUS_MOUSE_KEYS_BITMASK_EVENT_SIZE];
+	u32 expected[ASUS_MOUSE_DATA_KEY_STATE_NUM];
+	u32 actual[ASUS_MOUSE_DATA_KEY_STATE_NUM];
+	u32 seed = 0x12345678;
+	unsigned int n, i;
+
+	for (n = 0; n < 100000; n++) {
+		if (n == 0) {
+			memset(data, 0, sizeof(data));
+		} else if (n == 1) {
+			memset(data, 0xff, sizeof(data));
+		} else if (n < 2 + 8 * sizeof(data)) {
+			/* walk a single bit through the whole report */
+			memset(data, 0, sizeof(data));
+			data[(n - 2) / 8] = 1 << ((n - 2) % 8);
+		} else {
+			for (i = 0; i < sizeof(data); i++)
+				data[i] = asus_mouse_test_rand(&seed);
+		}
+
+		asus_mouse_test_unpack_bitmask(data, expected);
+		asus_mouse_unpack_bitmask(data, actual);
+		KUNIT_ASSERT_EQ_MSG(test, memcmp(expected, actual, sizeof(expected)), 0,
+			"expected %08x %08x %08x %08x, got %08x %08x %08x %08x",
+			expected[0], expected[1], expected[2], expected[3],
+			actual[0], actual[1], actual[2], actual[3]);
+	}
+}
+
+/*
+ * Sweeps the joystick through its whole range, one report per offset as from
+ * a stick held still: nothing comes out of the deadzone, the filter settles on
+ * the raw offset from the scroll ticks alone, speeds grow with the offset and
+ * are the same in both directions, the 16.16 remainder loses nothing over many
+ * ticks and scrolling stops on return to the center.
+ */
+static void asus_mouse_test_joystick(struct kunit *test) {
+	static const struct asus_mouse_curve curve = {
+		.type = ASUS_MOUSE_CURVE_EXP,
+		.points = 2,
+		.x = { 0, ASUS_MOUSE_JOYSTICK_OFFSET_MAX + 1 },
+		.y = { 4, 400 },
+	};
+	static const unsigned int tick_us = 1000, ticks = 10000;
+	struct asus_mouse_joystick js = { .deadzone = 16, .filter = 2, .curve = curve };
+	s32 step, prev = 0, rem, acc, out;
+	unsigned int i;
+	int raw;
+
+	asus_mouse_joystick_build(&js, tick_us);
+
+	for (raw = -128; raw < 128; raw++) {
+		memset(js.target, 0, sizeof(js.target));
+		memset(js.pos, 0, sizeof(js.pos));
+		asus_mouse_joystick_input(&js, 0, raw);
+		for (i = 0; i < 64; i++)
+			asus_mouse_joystick_tick(&js);
+		step = asus_mouse_joystick_step(&js, 0);
+
+		if (raw > -16 && raw < 16) {
+			KUNIT_ASSERT_EQ_MSG(test, step, 0, "offset %d inside the deadzone", raw);
+			KUNIT_ASSERT_FALSE_MSG(test, asus_mouse_joystick_active(&js),
+				"offset %d inside the deadzone", raw);
+		} else {
+			KUNIT_ASSERT_EQ_MSG(test, js.pos[0] >> 8, raw, "filter settled off offset %d", raw);
+		}
+		if (raw > 0)
+			KUNIT_ASSERT_GE_MSG(test, step, prev, "offset %d is slower than %d", raw, raw - 1);
+		if (raw > -128) {
+			memset(js.target, 0, sizeof(js.target));
+			memset(js.pos, 0, sizeof(js.pos));
+			asus_mouse_joystick_input(&js, 1, -raw);
+			for (i = 0; i < 64; i++)
+				asus_mouse_joystick_tick(&js);
+			KUNIT_ASSERT_EQ_MSG(test, asus_mouse_joystick_step(&js, 1), -step,
+				"offsets %d and %d differ in speed", raw, -raw);
+		}
+		if (raw >= 0)
+			prev = step;
+
+		/* what the scroll timer does with the step every tick */
+		rem = 0;
+		out = 0;
+		for (i = 0; i < ticks; i++) {
+			acc = rem + step;
+			out += acc >> 16;
+			rem = acc - (acc >> 16) * 65536;
+		}
+		KUNIT_ASSERT_EQ_MSG(test, (s64)out * 65536 + rem, (s64)step * ticks,
+			"offset %d lost motion over %u ticks", raw, ticks);
+
+		asus_mouse_joystick_input(&js, 0, 0);
+		asus_mouse_joystick_input(&js, 1, 0);
+		KUNIT_ASSERT_FALSE_MSG(test, asus_mouse_joystick_active(&js),
+			"offset %d did not return to the center", raw);
+	}
+
+	/* a stick just past the deadzone keeps the timer going until the filter gets there */
+	memset(js.target, 0, sizeof(js.target));
+	memset(js.pos, 0, sizeof(js.pos));
+	asus_mouse_joystick_input(&js, 0, 20);
+	asus_mouse_joystick_tick(&js);
+	KUNIT_EXPECT_EQ(test, asus_mouse_joystick_step(&js, 0), 0);
+	KUNIT_EXPECT_TRUE(test, asus_mouse_joystick_active(&js));
+	for (i = 0; i < 64; i++)
+		asus_mouse_joystick_tick(&js);
+	KUNIT_EXPECT_GT(test, asus_mouse_joystick_step(&js, 0), 0);
+}
+
+/*
+ * Spins the wheel into kinetic glides for every friction and a few ticks:
+ * a glide emits exactly the wheel motion scaled by the gain, slows down
+ * every tick and ends in a bounded number of ticks.
+ */
+static void asus_mouse_test_kinetic(struct kunit *test) {
+	static const unsigned int ticks_us[] = { 250, 1000, 16000 };
+	struct asus_mouse_kinetic kin = { .gain = 150 };
+	unsigned int t, n, notches;
+	s64 pushed, emitted;
+	u32 seed = 0x12345678;
+	s32 step, prev;
+	u64 len;
+
+	for (t = 0; t < ARRAY_SIZE(ticks_us); t++) {
+		for (kin.friction = 1; kin.friction <= ASUS_MOUSE_KINETIC_FRICTION_MAX; kin.friction++) {
+			asus_mouse_kinetic_build(&kin, ticks_us[t]);
+			notches = 1 + asus_mouse_test_rand(&seed) % 8;
+			kin.rest = 0;
+			pushed = 0;
+			for (n = 0; n < notches; n++) {
+				asus_mouse_kinetic_push(&kin, ASUS_MOUSE_MOUSE_WHEEL_RES);
+				pushed += div_s64((s64)ASUS_MOUSE_MOUSE_WHEEL_RES * kin.gain * 65536, 100);
+			}
+
+			emitted = 0;
+			prev = S32_MAX;
+			for (len = 0; asus_mouse_kinetic_active(&kin); len++) {
+				step = asus_mouse_kinetic_step(&kin);
+				KUNIT_ASSERT_GT_MSG(test, step, 0, "friction %u tick %u us",
+					kin.friction, ticks_us[t]);
+				KUNIT_ASSERT_LE_MSG(test, step, prev, "friction %u tick %u us speeds up",
+					kin.friction, ticks_us[t]);
+				KUNIT_ASSERT_LT_MSG(test, len, 100000000ull, "friction %u tick %u us never stops",
+					kin.friction, ticks_us[t]);
+				emitted += step;
+				prev = step;
+			}
+
+			KUNIT_ASSERT_EQ_MSG(test, emitted, pushed, "friction %u tick %u us",
+				kin.friction, ticks_us[t]);
+		}
+	}
+
+	/* turning the wheel back drops the glide */
+	asus_mouse_kinetic_push(&kin, ASUS_MOUSE_MOUSE_WHEEL_RES);
+	asus_mouse_kinetic_push(&kin, -ASUS_MOUSE_MOUSE_WHEEL_RES);
+	KUNIT_EXPECT_LT(test, asus_mouse_kinetic_step(&kin), 0);
+}
+
+/*
+ * Moves the pointer through long strokes of random reports for a few scales
+ * and curves: the motion sent must be exactly the scaled motion rounded down,
+ * the fractions left being the difference, and a neutral pipeline must send
+ * every report as it is.
+ */
+static void asus_mouse_test_pointer(struct kunit *test) {
+	static const unsigned int scales[] = { 1, 37, 100, 163, ASUS_MOUSE_POINTER_SCALE_MAX };
+	static const struct asus_mouse_curve curves[] = {
+		{ ASUS_MOUSE_CURVE_LINEAR, 2, { 0, 127 }, { 100, 100 } },
+		{ ASUS_MOUSE_CURVE_LINEAR, 2, { 0, 40 }, { 50, 300 } },
+		{ ASUS_MOUSE_CURVE_EXP, 2, { 0, 100 }, { 80, 1200 } },
+		{ ASUS_MOUSE_CURVE_CUSTOM, 3, { 2, 10, 60 }, { 0, 100, 250 } },
+	};
+	struct asus_mouse_pointer *ptr;
+	unsigned int s, c, n, axis;
+	s64 scaled[2], sent[2];
+	u32 seed = 0x12345678;
+	s32 x, y, rx, ry;
+	u32 factor;
+
+	ptr = kunit_kzalloc(test, sizeof(*ptr), GFP_KERNEL);
+	KUNIT_ASSERT_NOT_NULL(test, ptr);
+
+	for (s = 0; s < ARRAY_SIZE(scales); s++) {
+		for (c = 0; c < ARRAY_SIZE(curves); c++) {
+			ptr->scale = scales[s];
+			ptr->curve = curves[c];
+			asus_mouse_pointer_build(ptr);
+
+			for (axis = 0; axis < 2; axis++)
+				scaled[axis] = sent[axis] = 0;
+
+			for (n = 0; n < 100000; n++) {
+				/* mostly slow motion, some flicks up to the s16 range */
+				rx = (s32)(asus_mouse_test_rand(&seed) % 81) - 40;
+				ry = (s32)(asus_mouse_test_rand(&seed) % 81) - 40;
+				if (!(asus_mouse_test_rand(&seed) % 64)) {
+					rx *= 800;
+					ry *= 800;
+				}
+				x = rx;
+				y = ry;
+
+				factor = ptr->factor[asus_mouse_pointer_speed(rx, ry)];
+				scaled[0] += (s64)rx * factor;
+				scaled[1] += (s64)ry * factor;
+				asus_mouse_pointer_apply(ptr, &x, &y);
+				sent[0] += x;
+				sent[1] += y;
+
+				if (!ptr->active) {
+					KUNIT_ASSERT_EQ_MSG(test, x, rx, "neutral scale %u curve %u", scales[s], c);
+					KUNIT_ASSERT_EQ_MSG(test, y, ry, "neutral scale %u curve %u", scales[s], c);
+				}
+			}
+
+			for (axis = 0; axis < 2; axis++)
+				KUNIT_ASSERT_EQ_MSG(test, sent[axis] * 65536 + ptr->rest[axis], scaled[axis],
+					"scale %u curve %u axis %u", scales[s], c, axis);
+		}
+	}
+}
+
+/*
+ * Pushes ASUS_MOUSE_TEST_TIMED_REPORTS reports of one layout through
+ * raw_event, cycling through 256 made up ones, and reports the cost of one.
+ */
+static void asus_mouse_test_timed(struct kunit *test, unsigned int application, int size,
+		void (*fill)(u8 *report, int size, u32 *seed)) {
+	static u8 reports[256][ASUS_MOUSE_KEYS_BITMASK_EVENT_SIZE];
+	struct hid_device *hdev;
+	struct hid_report *report;
+	u64 ns, cycles;
+	u32 seed = 0x12345678;
+	unsigned int n;
+	u8 buf[ASUS_MOUSE_KEYS_BITMASK_EVENT_SIZE];
+
+	asus_mouse_test_bind(test, USB_DEVICE_ID_ASUSTEK_ROG_CHAKRAM_X_USB,
+		"kunit-0/input0", application, size);
+	hdev = asus_mouse_test_hdev(test, 0);
+	report = hdev->report_enum[HID_INPUT_REPORT].report_id_hash[0];
+
+	memset(reports, 0, sizeof(reports));
+	for (n = 0; n < ARRAY_SIZE(reports); n++)
+		fill(reports[n], size, &seed);
+
+	asus_mouse_test_log_reset(false);
+	ns = ktime_get_ns();
+	cycles = get_cycles();
+	for (n = 0; n < ASUS_MOUSE_TEST_TIMED_REPORTS; n++) {
+		/* raw_event may modify the report in place, like hid-core allows */
+		memcpy(buf, reports[n % ARRAY_SIZE(reports)], size);
+		asus_mouse_raw_event(hdev, report, buf, size);
+	}
+	cycles = get_cycles() - cycles;
+	ns = ktime_get_ns() - ns;
+
+	kunit_info(test, "%d-byte reports: %llu ns, %llu cycles per report, %lu events\n", size,
+		div_u64(ns, ASUS_MOUSE_TEST_TIMED_REPORTS), div_u64(cycles, ASUS_MOUSE_TEST_TIMED_REPORTS),
+		asus_mouse_test_log.total);
+	KUNIT_EXPECT_GT(test, asus_mouse_test_log.total, 0ul);
+}
+
+/* small random motion, a button toggled now and then */
+static void asus_mouse_test_fill_mouse(u8 *report, int size, u32 *seed) {
+	int xo = size == 11 ? 0 : 1;
+	int bo = size == 6 ? 0 : size == 7 ? 5 : 4;
+	s16 x = (s16)(asus_mouse_test_rand(seed) % 65) - 32;
+	s16 y = (s16)(asus_mouse_test_rand(seed) % 65) - 32;
+
+	put_unaligned_le16(x, report + xo);
+	put_unaligned_le16(y, report + xo + 2);
+	if (!(asus_mouse_test_rand(seed) % 16))
+		report[bo] = 1 << (asus_mouse_test_rand(seed) % 3);
+}
+
+/* one plain key or none, wheel keys and macros aren't timed */
+static void asus_mouse_test_fill_keyboard(u8 *report, int size, u32 *seed) {
+	u8 code = 4 + asus_mouse_test_rand(seed) % 26;  /* KEY_A...KEY_Z */
+
+	if (asus_mouse_test_rand(seed) & 1)
+		return;
+	if (size == ASUS_MOUSE_KEYS_BITMASK_EVENT_SIZE)
+		report[2 + code / 8] |= 1 << (code % 8);
+	else
+		report[size == 8 ? 2 : 3] = code;
+}
+
+/* the stick sweeping around its center */
+static void asus_mouse_test_fill_gamepad(u8 *report, int size, u32 *seed) {
+	int off = size == 5 ? 1 : 0;
+
+	report[off] = asus_mouse_test_rand(seed);
+	report[off + 1] = asus_mouse_test_rand(seed);
+}
+
+static void asus_mouse_test_timed_mouse6(struct kunit *test) {
+	asus_mouse_test_timed(test, HID_GD_MOUSE, 6, asus_mouse_test_fill_mouse);
+}
+
+static void asus_mouse_test_timed_mouse7(struct kunit *test) {
+	asus_mouse_test_timed(test, HID_GD_MOUSE, 7, asus_mouse_test_fill_mouse);
+}
+
+static void asus_mouse_test_timed_mouse11(struct kunit *test) {
+	asus_mouse_test_timed(test, HID_GD_MOUSE, 11, asus_mouse_test_fill_mouse);
+}
+
+static void asus_mouse_test_timed_keyboard8(struct kunit *test) {
+	asus_mouse_test_timed(test, HID_GD_KEYBOARD, 8, asus_mouse_test_fill_keyboard);
+}
+
+static void asus_mouse_test_timed_keyboard_bitmask(struct kunit *test) {
+	asus_mouse_test_timed(test, HID_GD_KEYBOARD, ASUS_MOUSE_KEYS_BITMASK_EVENT_SIZE,
+		asus_mouse_test_fill_keyboard);
+}
+
+static void asus_mouse_test_timed_gamepad5(struct kunit *test) {
+	asus_mouse_test_timed(test, HID_GD_GAMEPAD, 5, asus_mouse_test_fill_gamepad);
+}
+
+static struct kunit_case asus_mouse_test_cases[] = {
+	KUNIT_CASE(asus_mouse_test_mouse6),
+	KUNIT_CASE(asus_mouse_test_mouse7),
+	KUNIT_CASE(asus_mouse_test_mouse11),
+	KUNIT_CASE(asus_mouse_test_keyboard8),
+	KUNIT_CASE(asus_mouse_test_keyboard9),
+	KUNIT_CASE(asus_mouse_test_keyboard12),
+	KUNIT_CASE(asus_mouse_test_keyboard_bitmask),
+	KUNIT_CASE(asus_mouse_test_gamepad4),
+	KUNIT_CASE(asus_mouse_test_gamepad5),
+	KUNIT_CASE(asus_mouse_test_trace),
+	KUNIT_CASE(asus_mouse_test_remap),
+	KUNIT_CASE(asus_mouse_test_macro),
+	KUNIT_CASE(asus_mouse_test_profiles),
+	KUNIT_CASE(asus_mouse_test_grouping),
+	KUNIT_CASE(asus_mouse_test_dedup),
+	KUNIT_CASE(asus_mouse_test_resize),
+	KUNIT_CASE(asus_mouse_test_bitmask),
+	KUNIT_CASE(asus_mouse_test_joystick),
+	KUNIT_CASE(asus_mouse_test_kinetic),
+	KUNIT_CASE(asus_mouse_test_pointer),
+	KUNIT_CASE(asus_mouse_test_timed_mouse6),
+	KUNIT_CASE(asus_mouse_test_timed_mouse7),
+	KUNIT_CASE(asus_mouse_test_timed_mouse11),
+	KUNIT_CASE(asus_mouse_test_timed_keyboard8),
+	KUNIT_CASE(asus_mouse_test_timed_keyboard_bitmask),
+	KUNIT_CASE(asus_mouse_test_timed_gamepad5),
+	{ }
+};
+
+static struct kunit_suite asus_mouse_test_suite = {
+	.name = "hid-asus-mouse",
+	.init = asus_mouse_test_init,
+	.exit = asus_mouse_test_exit,
+	.test_cases = asus_mouse_test_cases,
+};
+
+kunit_test_suite(asus_mouse_test_suite);
@@ -0,0 +1,130 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Tracepoints of the HID driver for ASUS mice, enabled in
+ * "/sys/kernel/tracing/events/asus_mouse/"
+ *
+ * Copyright (c) 2022 Kyoken <kyoken@kyoken.ninja>
+ */
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM asus_mouse
+
+#if !defined(__HID_ASUS_MOUSE_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define __HID_ASUS_MOUSE_TRACE_H
+
+#include <linux/tracepoint.h>
+#include <linux/hid.h>
+
+#include "hid-asus-mouse.h"
+
+/* "0003:0B05:1A18.0004", or a mouse name: "1-2" or two Bluetooth addresses */
+#define ASUS_MOUSE_TRACE_DEV_LEN 40
+
+TRACE_EVENT(asus_mouse_raw_event,
+	TP_PROTO(struct hid_device *hdev, struct hid_report *report, const u8 *data, int size),
+	TP_ARGS(hdev, report, data, size),
+	TP_STRUCT__entry(
+		__array(char, dev, ASUS_MOUSE_TRACE_DEV_LEN)
+		__field(unsigned int, id)
+		__field(unsigned int, application)
+		__dynamic_array(u8, data, size)
+	),
+	TP_fast_assign(
+		strscpy(__entry->dev, dev_name(&hdev->dev), ASUS_MOUSE_TRACE_DEV_LEN);
+		__entry->id = report->id;
+		__entry->application = report->application;
+		memcpy(__get_dynamic_array(data), data, size);
+	),
+	TP_printk("%s id=%u application=0x%08x data=%s",
+		__entry->dev, __entry->id, __entry->application,
+		__print_hex(__get_dynamic_array(data), __get_dynamic_array_len(data)))
+);
+
+DECLARE_EVENT_CLASS(asus_mouse_input,
+	TP_PROTO(struct hid_device *hdev, const struct asus_mouse_event *ev),
+	TP_ARGS(hdev, ev),
+	TP_STRUCT__entry(
+		__array(char, dev, ASUS_MOUSE_TRACE_DEV_LEN)
+		__field(u16, type)
+		__field(u16, code)
+		__field(s32, value)
+	),
+	TP_fast_assign(
+		strscpy(__entry->dev, dev_name(&hdev->dev), ASUS_MOUSE_TRACE_DEV_LEN);
+		__entry->type = ev->type;
+		__entry->code = ev->code;
+		__entry->value = ev->value;
+	),
+	TP_printk("%s type=%u code=%u value=%d",
+		__entry->dev, __entry->type, __entry->code, __entry->value)
+);
+
+/* decoded events of mouse, keyboard and gamepad reports, before the scroll emulation */
+DEFINE_EVENT(asus_mouse_input, asus_mouse_mouse,
+	TP_PROTO(struct hid_device *hdev, const struct asus_mouse_event *ev),
+	TP_ARGS(hdev, ev)
+);
+
+DEFINE_EVENT(asus_mouse_input, asus_mouse_key,
+	TP_PROTO(struct hid_device *hdev, const struct asus_mouse_event *ev),
+	TP_ARGS(hdev, ev)
+);
+
+DEFINE_EVENT(asus_mouse_input, asus_mouse_joystick,
+	TP_PROTO(struct hid_device *hdev, const struct asus_mouse_event *ev),
+	TP_ARGS(hdev, ev)
+);
+
+/* "key_state" before and after a keyboard report, highest key codes first */
+TRACE_EVENT(asus_mouse_key_state,
+	TP_PROTO(struct hid_device *hdev, const u32 *old_state, const u32 *new_state),
+	TP_ARGS(hdev, old_state, new_state),
+	TP_STRUCT__entry(
+		__array(char, dev, ASUS_MOUSE_TRACE_DEV_LEN)
+		__array(u32, old_state, ASUS_MOUSE_DATA_KEY_STATE_NUM)
+		__array(u32, new_state, ASUS_MOUSE_DATA_KEY_STATE_NUM)
+	),
+	TP_fast_assign(
+		strscpy(__entry->dev, dev_name(&hdev->dev), ASUS_MOUSE_TRACE_DEV_LEN);
+		memcpy(__entry->old_state, old_state, sizeof(__entry->old_state));
+		memcpy(__entry->new_state, new_state, sizeof(__entry->new_state));
+	),
+	TP_printk("%s state=%08x%08x%08x%08x changed=%08x%08x%08x%08x",
+		__entry->dev,
+		__entry->new_state[0], __entry->new_state[1],
+		__entry->new_state[2], __entry->new_state[3],
+		__entry->old_state[0] ^ __entry->new_state[0],
+		__entry->old_state[1] ^ __entry->new_state[1],
+		__entry->old_state[2] ^ __entry->new_state[2],
+		__entry->old_state[3] ^ __entry->new_state[3])
+);
+
+/* emulated wheel step, amounts in 16.16 hi-res units before the remainders */
+TRACE_EVENT(asus_mouse_scroll_tick,
+	TP_PROTO(struct asus_mouse_device *device, s32 wheel, s32 hwheel),
+	TP_ARGS(device, wheel, hwheel),
+	TP_STRUCT__entry(
+		__array(char, dev, ASUS_MOUSE_TRACE_DEV_LEN)
+		__field(unsigned int, ticks)
+		__field(unsigned int, repeat_key)
+		__field(s32, wheel)
+		__field(s32, hwheel)
+	),
+	TP_fast_assign(
+		strscpy(__entry->dev, device->name, ASUS_MOUSE_TRACE_DEV_LEN);
+		__entry->ticks = device->scroll_ticks;
+		__entry->repeat_key = device->repeat_key;
+		__entry->wheel = wheel;
+		__entry->hwheel = hwheel;
+	),
+	TP_printk("%s ticks=%u key=%u wheel=%d hwheel=%d",
+		__entry->dev, __entry->ticks, __entry->repeat_key, __entry->wheel, __entry->hwheel)
+);
+
+#endif
+
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE hid-asus-mouse-trace
+#include <trace/define_trace.h>
@@ -0,0 +1,1345 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * uhid simulator of ASUS mice for end-to-end tests and benchmarks
+ *
+ * Copyright (c) 2022 Kyoken <kyoken@kyoken.ninja>
+ *
+ * Creates the mouse, keyboard and gamepad interfaces of a mouse through
+ * /dev/uhid with the real ASUS vendor and product IDs, so the loaded driver
+ * binds to them like to a real device, replays synthetic or recorded reports
+ * at a fixed rate and reads the resulting "ASUS mouse input" evdev nodes.
+ * It reports throughput, end-to-end latency from the report write to the
+ * read of its event, and lost motion, with no mouse attached. As the driver
+ * stamps frames with the arrival of their report, the offset of the event
+ * timestamp from the write is reported apart, and the error of the intervals
+ * between the timestamps of consecutive reports against the intervals they
+ * were written at is their jitter.
+ *
+ * Synthetic mouse reports move X by exactly 1, so every received frame tells
+ * how many reports it carries and frames are matched to reports in order even
+ * when the driver coalesces motion. Recorded streams use the format of the
+ * decoder benchmark and are checked for motion conservation only. Captures of
+ * the driver's debugfs ring are replayed with their original timing, all the
+ * captured interfaces going through the simulated one of the same application.
+ * An optional vendor interface answers the configuration commands of the
+ * driver's sysfs attributes like the mouse firmware and logs them, and the
+ * settings written through the mouse interface must reach it. The send
+ * can wait after the driver has bound, e.g. for HID-BPF programs to attach to
+ * the simulated interfaces, and reports dropped by the driver are read from
+ * its stats at the end. A mouse on its RF receiver and its cable at once is
+ * simulated by a second mouse interface with the other product ID, getting
+ * the same synthetic reports, of which the driver must decode one path only.
+ * The first path goes quiet with a button held and the second one takes over
+ * with it released, which must leave no key held.
+ * The HID-BPF normalizer can be attached to the interfaces with udev-hid-bpf,
+ * then only the layouts it rewrites into may reach the driver, none dropped
+ * and no motion lost.
+ *
+ * Needs root, or write access to /dev/uhid and read access to /dev/input.
+ */
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include "hid-asus-mouse.h"
+
+#include <linux/input.h>
+#include <linux/uhid.h>
+
+#define SIM_INTERFACES_MAX 4
+#define SIM_INPUTS_MAX 8
+#define SIM_REPORT_SIZE_MAX 64
+#define SIM_RATE_MAX 8000
+#define SIM_PENDING_SIZE 65536  /* sent mouse reports not seen in a frame yet */
+#define SIM_INPUT_NAME "ASUS mouse input"
+#define SIM_INPUT_WAIT_MS 2000  /* for the driver to bind a new interface */
+#define SIM_DRAIN_MS 200
+#define SIM_SIDE_TRAFFIC 64  /* one keyboard and one gamepad report per that many mouse reports */
+#define SIM_VENDOR_APPLICATION ((u32)ASUS_MOUSE_VENDOR_PAGE << 16 | 0x01)
+#define SIM_VENDOR_SIZE 64
+#define SIM_VENDOR_WAIT_MS 3000  /* for the driver to send and save the settings */
+#define SIM_BPF_TOOL "udev-hid-bpf"  /* overridden by $UDEV_HID_BPF */
+#define SIM_BPF_MOUSE_SIZE 7  /* layouts hid-asus-mouse.bpf.c rewrites into */
+#define SIM_BPF_GAMEPAD_SIZE 5
+
+struct sim_product {
+	const char *name;
+	u16 product;
+	bool joystick;
+};
+
+#define SIM_PRODUCT(_name, _joystick) \
+	{ #_name, USB_DEVICE_ID_ASUSTEK_ROG_##_name, _joystick }
+
+static const struct sim_product sim_products[] = {
+	SIM_PRODUCT(BUZZARD, false),
+	SIM_PRODUCT(CHAKRAM_RF, true),
+	SIM_PRODUCT(CHAKRAM_USB, true),
+	SIM_PRODUCT(CHAKRAM_X_BT, true),
+	SIM_PRODUCT(CHAKRAM_X_RF, true),
+	SIM_PRODUCT(CHAKRAM_X_USB, true),
+	SIM_PRODUCT(GLADIUS2, false),
+	SIM_PRODUCT(GLADIUS2_CORE, false),
+	SIM_PRODUCT(GLADIUS2_ORIGIN, false),
+	SIM_PRODUCT(GLADIUS2_ORIGIN_PINK, false),
+	SIM_PRODUCT(GLADIUS3, false),
+	SIM_PRODUCT(GLADIUS3_WIRELESS, false),
+	SIM_PRODUCT(GLADIUS3_WIRELESS_AIMPOINT_RF, false),
+	SIM_PRODUCT(GLADIUS3_WIRELESS_AIMPOINT_USB, false),
+	SIM_PRODUCT(KERIS_WIRELESS_AIMPOINT_RF, false),
+	SIM_PRODUCT(KERIS_WIRELESS_AIMPOINT_USB, false),
+	SIM_PRODUCT(KERIS_WIRELESS_RF, false),
+	SIM_PRODUCT(KERIS_WIRELESS_USB, false),
+	SIM_PRODUCT(PUGIO, false),
+	SIM_PRODUCT(PUGIO2_RF, false),
+	SIM_PRODUCT(PUGIO2_USB, false),
+	SIM_PRODUCT(SPATHA_RF, false),
+	SIM_PRODUCT(SPATHA_USB, false),
+	SIM_PRODUCT(SPATHA_X_RF, false),
+	SIM_PRODUCT(SPATHA_X_USB, false),
+	SIM_PRODUCT(STRIX_CARRY, false),
+	SIM_PRODUCT(STRIX_IMPACT, false),
+	SIM_PRODUCT(STRIX_IMPACT2_ELECTRO_PUNK, false),
+	SIM_PRODUCT(STRIX_IMPACT2_WIRELESS_RF, false),
+	SIM_PRODUCT(STRIX_IMPACT2_WIRELESS_USB, false),
+	{ "TUF_GAMING_M3", USB_DEVICE_ID_ASUSTEK_TUF_GAMING_M3, false },
+};
+
+/* one uhid device stands for one USB interface */
+struct sim_interface {
+	u32 application;
+	int size;
+	int fd;
+	unsigned long sent;
+	char phys[64];  /* shared by the interfaces of one simulated mouse up to "/input" */
+	char name[32];  /* in /sys/bus/hid/devices, "" if not found */
+};
+
+struct sim_report {
+	struct sim_interface *iface;
+	u64 time_ns;  /* arrival in a capture, 0 for text streams */
+	u8 data[SIM_REPORT_SIZE_MAX];
+};
+
+struct sim_pending {
+	u64 sent_ns;
+};
+
+static struct sim_interface sim_interfaces[SIM_INTERFACES_MAX];
+static int sim_interfaces_num;
+static int sim_inputs[SIM_INPUTS_MAX];
+static int sim_inputs_num;
+static bool sim_verbose;
+
+/* written by the sender, consumed by the reader */
+static struct sim_pending sim_pending[SIM_PENDING_SIZE];
+static unsigned long sim_pending_head;
+static bool sim_stop;
+
+/* reader results */
+static unsigned long sim_frames;
+static unsigned long sim_motion_frames;
+static unsigned long sim_syn_dropped;
+static long sim_motion_received;
+static unsigned long sim_matched;
+static unsigned long sim_vendor_set;  /* settings acknowledged */
+static unsigned long sim_vendor_saved;  /* saves acknowledged after the last setting */
+struct sim_samples {
+	u64 *ns;
+	size_t num;
+	size_t capacity;
+};
+
+static struct sim_samples sim_latency;  /* report write to the read of its event */
+static struct sim_samples sim_stamp_offset;  /* report write to the timestamp of its event */
+static struct sim_samples sim_jitter;  /* absolute interval errors */
+
+static u64 sim_now_ns(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (u64)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static const char *sim_app_name(u32 application) {
+	switch(application) {
+	case HID_GD_MOUSE:
+		return "mouse";
+	case HID_GD_KEYBOARD:
+		return "keyboard";
+	case HID_GD_GAMEPAD:
+		return "gamepad";
+	case SIM_VENDOR_APPLICATION:
+		return "vendor";
+	default:
+		return "unknown";
+	}
+}
+
+/*
+ * The driver decodes raw bytes by the application of their collection and
+ * the report length only, so every interface describes its single unnumbered
+ * report as plain vendor bytes of the length of the simulated layout.
+ */
+static size_t sim_descriptor(u8 *rd, u32 application, int size) {
+	size_t n = 0;
+
+	if (application == SIM_VENDOR_APPLICATION) {
+		/* commands go out and answers come in through reports of the same length */
+		rd[n++] = 0x06; rd[n++] = 0x01; rd[n++] = 0xff;  /* Usage Page (Vendor 0xff01) */
+		rd[n++] = 0x09; rd[n++] = 0x01;  /* Usage (1) */
+		rd[n++] = 0xa1; rd[n++] = 0x01;  /* Collection (Application) */
+		rd[n++] = 0x15; rd[n++] = 0x00;  /* Logical Minimum (0) */
+		rd[n++] = 0x26; rd[n++] = 0xff; rd[n++] = 0x00;  /* Logical Maximum (255) */
+		rd[n++] = 0x75; rd[n++] = 0x08;  /* Report Size (8) */
+		rd[n++] = 0x95; rd[n++] = size;  /* Report Count (size) */
+		rd[n++] = 0x09; rd[n++] = 0x01;  /* Usage (1) */
+		rd[n++] = 0x81; rd[n++] = 0x02;  /* Input (Data, Variable, Absolute) */
+		rd[n++] = 0x09; rd[n++] = 0x01;  /* Usage (1) */
+		rd[n++] = 0x91; rd[n++] = 0x02;  /* Output (Data, Variable, Absolute) */
+		rd[n++] = 0xc0;  /* End Collection */
+		return n;
+	}
+
+	rd[n++] = 0x05; rd[n++] = 0x01;  /* Usage Page (Generic Desktop) */
+	rd[n++] = 0x09; rd[n++] = application & 0xff;  /* Usage (Mouse, Keyboard or Gamepad) */
+	rd[n++] = 0xa1; rd[n++] = 0x01;  /* Collection (Application) */
+	rd[n++] = 0x06; rd[n++] = 0x00; rd[n++] = 0xff;  /* Usage Page (Vendor 0xff00) */
+	rd[n++] = 0x09; rd[n++] = 0x01;  /* Usage (1) */
+	rd[n++] = 0x15; rd[n++] = 0x00;  /* Logical Minimum (0) */
+	rd[n++] = 0x26; rd[n++] = 0xff; rd[n++] = 0x00;  /* Logical Maximum (255) */
+	rd[n++] = 0x75; rd[n++] = 0x08;  /* Report Size (8) */
+	rd[n++] = 0x95; rd[n++] = size;  /* Report Count (size) */
+	rd[n++] = 0x81; rd[n++] = 0x02;  /* Input (Data, Variable, Absolute) */
+	rd[n++] = 0xc0;  /* End Collection */
+	return n;
+}
+
+static int sim_write(int fd, const struct uhid_event *ev) {
+	ssize_t ret;
+
+	ret = write(fd, ev, sizeof(*ev));
+	if (ret < 0)
+		return -errno;
+	if (ret != sizeof(*ev))
+		return -EFAULT;
+	return 0;
+}
+
+static struct sim_interface *sim_interface_create(
+		const struct sim_product *product, u32 application, int size) {
+	struct sim_interface *iface = &sim_interfaces[sim_interfaces_num];
+	struct uhid_event ev;
+	int ret;
+
+	iface->fd = open("/dev/uhid", O_RDWR | O_CLOEXEC);
+	if (iface->fd < 0) {
+		perror("/dev/uhid");
+		exit(1);
+	}
+
+	memset(&ev, 0, sizeof(ev));
+	ev.type = UHID_CREATE2;
+	snprintf((char *)ev.u.create2.name, sizeof(ev.u.create2.name),
+			 "ASUSTeK ROG %s (simulated %s)", product->name, sim_app_name(application));
+	/* the driver groups the interfaces of a mouse by their phys, without a USB device */
+	snprintf(iface->phys, sizeof(iface->phys), "hid-asus-mouse-uhid-%04x/input%d",
+			 product->product, sim_interfaces_num);
+	memcpy(ev.u.create2.phys, iface->phys, sizeof(iface->phys));
+	ev.u.create2.rd_size = sim_descriptor(ev.u.create2.rd_data, application, size);
+	ev.u.create2.bus = BUS_USB;
+	ev.u.create2.vendor = USB_VENDOR_ID_ASUSTEK;
+	ev.u.create2.product = product->product;
+
+	ret = sim_write(iface->fd, &ev);
+	if (ret) {
+		fprintf(stderr, "uhid create: %s\n", strerror(-ret));
+		exit(1);
+	}
+
+	iface->application = application;
+	iface->size = size;
+	sim_interfaces_num++;
+	return iface;
+}
+
+static void sim_interface_destroy(struct sim_interface *iface) {
+	struct uhid_event ev;
+
+	memset(&ev, 0, sizeof(ev));
+	ev.type = UHID_DESTROY;
+	sim_write(iface->fd, &ev);
+	close(iface->fd);
+}
+
+static struct sim_interface *sim_interface_find(u32 application) {
+	int i;
+
+	for (i = 0; i < sim_interfaces_num; i++)
+		if (sim_interfaces[i].application == application)
+			return &sim_interfaces[i];
+	return NULL;
+}
+
+static void sim_send(struct sim_interface *iface, const u8 *data, int size) {
+	struct uhid_event ev;
+	int ret;
+
+	memset(&ev, 0, sizeof(ev));
+	ev.type = UHID_INPUT2;
+	ev.u.input2.size = size;
+	memcpy(ev.u.input2.data, data, size);
+
+	ret = sim_write(iface->fd, &ev);
+	if (ret) {
+		fprintf(stderr, "uhid input: %s\n", strerror(-ret));
+		exit(1);
+	}
+	iface->sent++;
+}
+
+/* acknowledges a command like the firmware, by echoing its header */
+static void sim_vendor_answer(struct sim_interface *iface, const u8 *data, int size) {
+	u8 answer[SIM_VENDOR_SIZE] = { 0 };
+
+	if (size < ASUS_MOUSE_VENDOR_CMD_SIZE)
+		return;
+
+	printf("vendor: command 0x%04x field %u value %u\n",
+		   data[0] | data[1] << 8, data[2], data[4] | data[5] << 8);
+	memcpy(answer, data, ASUS_MOUSE_VENDOR_CMD_SIZE);
+	sim_send(iface, answer, iface->size);
+
+	switch(data[0] | data[1] << 8) {
+	case ASUS_MOUSE_CMD_SET_SETTING:
+		__atomic_store_n(&sim_vendor_saved, 0, __ATOMIC_RELEASE);
+		__atomic_add_fetch(&sim_vendor_set, 1, __ATOMIC_RELEASE);
+		break;
+	case ASUS_MOUSE_CMD_SAVE:
+		__atomic_add_fetch(&sim_vendor_saved, 1, __ATOMIC_RELEASE);
+		break;
+	default:
+		break;
+	}
+}
+
+/* answers the requests of the driver, so it never waits for a timeout */
+static void sim_handle_uhid(struct sim_interface *iface) {
+	struct uhid_event ev, reply;
+
+	if (read(iface->fd, &ev, sizeof(ev)) <= 0)
+		return;
+
+	memset(&reply, 0, sizeof(reply));
+	switch(ev.type) {
+	case UHID_GET_REPORT:
+		reply.type = UHID_GET_REPORT_REPLY;
+		reply.u.get_report_reply.id = ev.u.get_report.id;
+		reply.u.get_report_reply.err = EIO;
+		sim_write(iface->fd, &reply);
+		break;
+	case UHID_SET_REPORT:
+		reply.type = UHID_SET_REPORT_REPLY;
+		reply.u.set_report_reply.id = ev.u.set_report.id;
+		sim_write(iface->fd, &reply);
+		break;
+	case UHID_OUTPUT:
+		if (iface->application == SIM_VENDOR_APPLICATION)
+			sim_vendor_answer(iface, ev.u.output.data, ev.u.output.size);
+		break;
+	default:
+		break;
+	}
+
+	if (sim_verbose)
+		fprintf(stderr, "%s: uhid event %u\n", sim_app_name(iface->application), ev.type);
+}
+
+static bool sim_input_is_driver(int fd) {
+	char name[64] = "";
+
+	if (ioctl(fd, EVIOCGNAME(sizeof(name)), name) < 0)
+		return false;
+	return !strcmp(name, SIM_INPUT_NAME);
+}
+
+/* waits until the driver has bound the interface and opened it at the end of probe */
+static void sim_interface_wait(struct sim_interface *iface) {
+	struct pollfd pfd = { .fd = iface->fd, .events = POLLIN };
+	u64 deadline = sim_now_ns() + SIM_INPUT_WAIT_MS * 1000000ull;
+	struct uhid_event ev;
+
+	while (sim_now_ns() < deadline) {
+		if (poll(&pfd, 1, 10) <= 0)
+			continue;
+		if (read(iface->fd, &ev, sizeof(ev)) <= 0)
+			continue;
+		if (ev.type == UHID_OPEN)
+			return;
+	}
+
+	fprintf(stderr, "%s interface not opened, is the driver loaded?\n",
+			sim_app_name(iface->application));
+	exit(1);
+}
+
+/* finds the HID device of an interface by the phys it was created with */
+static void sim_interface_name(struct sim_interface *iface) {
+	char path[300], line[128], phys[96];
+	struct dirent *de;
+	bool found;
+	FILE *f;
+	DIR *dir;
+
+	snprintf(phys, sizeof(phys), "HID_PHYS=%s\n", iface->phys);
+	dir = opendir("/sys/bus/hid/devices");
+	if (!dir)
+		return;
+	while ((de = readdir(dir))) {
+		if (de->d_name[0] == '.')
+			continue;
+		snprintf(path, sizeof(path), "/sys/bus/hid/devices/%s/uevent", de->d_name);
+		f = fopen(path, "r");
+		if (!f)
+			continue;
+		found = false;
+		while (!found && fgets(line, sizeof(line), f))
+			found = !strcmp(line, phys);
+		fclose(f);
+		if (found) {
+			snprintf(iface->name, sizeof(iface->name), "%.31s", de->d_name);
+			break;
+		}
+	}
+	closedir(dir);
+}
+
+/* reports of an interface dropped by the driver, -1 if unknown */
+static long sim_interface_dropped(const struct sim_interface *iface) {
+	char path[300];
+	long dropped;
+	FILE *f;
+
+	if (!iface->name[0])
+		return -1;
+	snprintf(path, sizeof(path), "/sys/bus/hid/devices/%s/stats/dropped", iface->name);
+	f = fopen(path, "r");
+	if (!f)
+		return -1;
+	if (fscanf(f, "%ld", &dropped) != 1)
+		dropped = -1;
+	fclose(f);
+	return dropped;
+}
+
+/* writes a sysfs attribute of an interface, false if the driver refuses the value */
+static bool sim_interface_write(const struct sim_interface *iface, const char *attr, const char *value) {
+	char path[300];
+	bool ok;
+	FILE *f;
+
+	if (!iface->name[0])
+		return false;
+	snprintf(path, sizeof(path), "/sys/bus/hid/devices/%s/%s", iface->name, attr);
+	f = fopen(path, "w");
+	if (!f)
+		return false;
+	ok = fputs(value, f) >= 0;
+	/* the store runs on the flush */
+	if (fclose(f))
+		ok = false;
+	return ok;
+}
+
+/*
+ * Settings written to the mouse interface go out through the vendor interface,
+ * a separate HID device, so they only arrive when the driver took both for one
+ * mouse. Waits for them to be acknowledged and saved.
+ */
+static bool sim_vendor_check(const struct sim_interface *mouse) {
+	u64 deadline = sim_now_ns() + SIM_VENDOR_WAIT_MS * 1000000ull;
+	unsigned long set, saved;
+
+	if (!sim_interface_write(mouse, "dpi", "800") || !sim_interface_write(mouse, "polling_rate", "1000")) {
+		fprintf(stderr, "vendor: the driver refused the settings of the mouse interface\n");
+		return false;
+	}
+
+	do {
+		usleep(1000);
+		set = __atomic_load_n(&sim_vendor_set, __ATOMIC_ACQUIRE);
+		saved = __atomic_load_n(&sim_vendor_saved, __ATOMIC_ACQUIRE);
+	} while ((set < 2 || !saved) && sim_now_ns() < deadline);
+
+	if (set < 2 || !saved) {
+		fprintf(stderr, "vendor: %lu of 2 settings acknowledged, %s\n", set, saved ? "saved" : "not saved");
+		return false;
+	}
+	return true;
+}
+
+/* attaches a HID-BPF program to an interface through udev-hid-bpf */
+static bool sim_bpf_attach(const struct sim_interface *iface, const char *object) {
+	const char *tool = getenv("UDEV_HID_BPF") ? getenv("UDEV_HID_BPF") : SIM_BPF_TOOL;
+	char path[300];
+	int status;
+	pid_t pid;
+
+	if (!iface->name[0])
+		return false;
+	snprintf(path, sizeof(path), "/sys/bus/hid/devices/%s", iface->name);
+
+	pid = fork();
+	if (pid < 0)
+		return false;
+	if (!pid) {
+		execlp(tool, tool, "add", path, object, (char *)NULL);
+		perror(tool);
+		_exit(127);
+	}
+	if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status)) {
+		fprintf(stderr, "bpf: %s %s not attached to %s\n", tool, object, path);
+		return false;
+	}
+	return true;
+}
+
+/*
+ * With the normalizer attached, the driver must have seen the reports of an
+ * interface in the layout of its application only, and dropped none of them.
+ */
+static bool sim_bpf_check(const struct sim_interface *iface) {
+	char path[300], len[8];
+	unsigned long count, total = 0;
+	bool ok = true;
+	int expected;
+	FILE *f;
+
+	switch(iface->application) {
+	case HID_GD_MOUSE:
+		expected = SIM_BPF_MOUSE_SIZE;
+		break;
+	case HID_GD_KEYBOARD:
+		expected = ASUS_MOUSE_KEYS_BITMASK_EVENT_SIZE;
+		break;
+	case HID_GD_GAMEPAD:
+		expected = SIM_BPF_GAMEPAD_SIZE;
+		break;
+	default:
+		return true;
+	}
+
+	snprintf(path, sizeof(path), "/sys/bus/hid/devices/%s/stats/reports_size", iface->name);
+	f = fopen(path, "r");
+	if (!f) {
+		perror(path);
+		return false;
+	}
+	while (fscanf(f, "%7s %lu", len, &count) == 2) {
+		total += count;
+		if (atoi(len) != expected || strchr(len, '+')) {
+			fprintf(stderr, "bpf: %lu %s reports of %s bytes reached the driver, not %d\n",
+					count, sim_app_name(iface->application), len, expected);
+			ok = false;
+		}
+	}
+	fclose(f);
+
+	if (total < iface->sent) {
+		fprintf(stderr, "bpf: %lu of %lu %s reports reached the driver\n",
+				total, iface->sent, sim_app_name(iface->application));
+		ok = false;
+	}
+	if (sim_interface_dropped(iface)) {
+		fprintf(stderr, "bpf: %s reports dropped\n", sim_app_name(iface->application));
+		ok = false;
+	}
+	return ok;
+}
+
+/* the driver's "dedup_quiet_ms", its default if it can't be read */
+static unsigned int sim_dedup_quiet_ms(void) {
+	unsigned int ms = ASUS_MOUSE_DEDUP_QUIET_MS;
+	FILE *f;
+
+	f = fopen("/sys/module/hid_asus_mouse/parameters/dedup_quiet_ms", "r");
+	if (!f)
+		return ms;
+	if (fscanf(f, "%u", &ms) != 1)
+		ms = ASUS_MOUSE_DEDUP_QUIET_MS;
+	fclose(f);
+	return ms;
+}
+
+/* false if an input node still has a key or button down */
+static bool sim_keys_released(void) {
+	unsigned long keys[KEY_CNT / (8 * sizeof(unsigned long)) + 1];
+	bool ok = true;
+	int i, code;
+
+	for (i = 0; i < sim_inputs_num; i++) {
+		memset(keys, 0, sizeof(keys));
+		if (ioctl(sim_inputs[i], EVIOCGKEY(sizeof(keys)), keys) < 0)
+			continue;
+		for (code = 0; code < KEY_CNT; code++) {
+			if (keys[code / (8 * sizeof(unsigned long))] & (1ul << (code % (8 * sizeof(unsigned long))))) {
+				fprintf(stderr, "failover: key 0x%x held\n", code);
+				ok = false;
+			}
+		}
+	}
+	return ok;
+}
+
+/*
+ * Opens every "ASUS mouse input" node: the shared one or, with the
+ * "per_device_input" option, one per simulated interface.
+ */
+static void sim_inputs_open(void) {
+	int fd, i, clock = CLOCK_MONOTONIC;
+	struct input_event ev;
+	char path[300];
+	struct dirent *de;
+	DIR *dir;
+
+	for (i = 0; i < sim_interfaces_num; i++) {
+		sim_interface_wait(&sim_interfaces[i]);
+		sim_interface_name(&sim_interfaces[i]);
+	}
+
+	dir = opendir("/dev/input");
+	if (!dir) {
+		perror("/dev/input");
+		exit(1);
+	}
+	while ((de = readdir(dir)) && sim_inputs_num < SIM_INPUTS_MAX) {
+		if (strncmp(de->d_name, "event", 5))
+			continue;
+		snprintf(path, sizeof(path), "/dev/input/%s", de->d_name);
+		fd = open(path, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+		if (fd < 0)
+			continue;
+		if (!sim_input_is_driver(fd)) {
+			close(fd);
+			continue;
+		}
+		sim_inputs[sim_inputs_num++] = fd;
+	}
+	closedir(dir);
+
+	if (!sim_inputs_num) {
+		fprintf(stderr, "no \"%s\" node\n", SIM_INPUT_NAME);
+		exit(1);
+	}
+
+	for (i = 0; i < sim_inputs_num; i++) {
+		/* event timestamps in the clock of the sender, not wall time */
+		ioctl(sim_inputs[i], EVIOCSCLOCKID, &clock);
+		/* keep the simulated motion away from the desktop cursor */
+		ioctl(sim_inputs[i], EVIOCGRAB, 1);
+		while (read(sim_inputs[i], &ev, sizeof(ev)) > 0)
+			;
+	}
+}
+
+static void sim_samples_add(struct sim_samples *samples, u64 ns) {
+	if (samples->num == samples->capacity) {
+		samples->capacity = samples->capacity ? samples->capacity * 2 : 4096;
+		samples->ns = realloc(samples->ns, samples->capacity * sizeof(*samples->ns));
+		if (!samples->ns) {
+			perror("realloc");
+			exit(1);
+		}
+	}
+	samples->ns[samples->num++] = ns;
+}
+
+/*
+ * A frame moving X by "count" carries the next "count" synthetic reports,
+ * its latency is counted from the write of the last of them to "read_ns".
+ */
+static void sim_frame_match(long count, u64 frame_ns, u64 read_ns, unsigned long *tail) {
+	static u64 prev_frame_ns, prev_sent_ns;
+	static unsigned long prev_tail;
+	unsigned long head = __atomic_load_n(&sim_pending_head, __ATOMIC_ACQUIRE);
+	bool single = count == 1;
+	u64 sent_ns = 0;
+	s64 error;
+
+	for (; count > 0 && *tail < head; count--, (*tail)++) {
+		sent_ns = sim_pending[*tail % SIM_PENDING_SIZE].sent_ns;
+		sim_matched++;
+	}
+
+	if (!sent_ns)
+		return;
+	if (read_ns >= sent_ns)
+		sim_samples_add(&sim_latency, read_ns - sent_ns);
+	if (frame_ns >= sent_ns)
+		sim_samples_add(&sim_stamp_offset, frame_ns - sent_ns);
+
+	/* frames of one report each, following each other */
+	if (single && prev_tail && prev_tail + 1 == *tail) {
+		error = (s64)(frame_ns - prev_frame_ns) - (s64)(sent_ns - prev_sent_ns);
+		sim_samples_add(&sim_jitter, error < 0 ? -error : error);
+	}
+	prev_tail = single ? *tail : 0;
+	prev_frame_ns = frame_ns;
+	prev_sent_ns = sent_ns;
+}
+
+static void sim_handle_input(int fd, bool synthetic, unsigned long *tail) {
+	static long frame_x;
+	struct input_event ev;
+	u64 ns;
+
+	while (read(fd, &ev, sizeof(ev)) == sizeof(ev)) {
+		if (ev.type == EV_REL && ev.code == REL_X) {
+			frame_x += ev.value;
+			continue;
+		}
+		if (ev.type != EV_SYN)
+			continue;
+
+		if (ev.code == SYN_DROPPED) {
+			/* the evdev buffer overflowed, frames up to now can't be matched */
+			sim_syn_dropped++;
+			*tail = __atomic_load_n(&sim_pending_head, __ATOMIC_ACQUIRE);
+			frame_x = 0;
+			continue;
+		}
+		if (ev.code != SYN_REPORT)
+			continue;
+
+		sim_frames++;
+		if (frame_x) {
+			sim_motion_frames++;
+			sim_motion_received += frame_x;
+			ns = (u64)ev.input_event_sec * 1000000000ull + ev.input_event_usec * 1000ull;
+			if (synthetic)
+				sim_frame_match(frame_x, ns, sim_now_ns(), tail);
+		}
+		frame_x = 0;
+	}
+}
+
+static void *sim_reader(void *arg) {
+	struct pollfd fds[SIM_INPUTS_MAX + SIM_INTERFACES_MAX];
+	bool synthetic = arg != NULL;
+	unsigned long tail = 0;
+	int i, n = 0;
+
+	for (i = 0; i < sim_inputs_num; i++) {
+		fds[n].fd = sim_inputs[i];
+		fds[n++].events = POLLIN;
+	}
+	for (i = 0; i < sim_interfaces_num; i++) {
+		fds[n].fd = sim_interfaces[i].fd;
+		fds[n++].events = POLLIN;
+	}
+
+	while (!__atomic_load_n(&sim_stop, __ATOMIC_ACQUIRE)) {
+		if (poll(fds, n, 10) <= 0)
+			continue;
+		for (i = 0; i < n; i++) {
+			if (!(fds[i].revents & POLLIN))
+				continue;
+			if (i < sim_inputs_num)
+				sim_handle_input(fds[i].fd, synthetic, &tail);
+			else
+				sim_handle_uhid(&sim_interfaces[i - sim_inputs_num]);
+		}
+	}
+
+	return NULL;
+}
+
+static void sim_mouse_report(u8 *r, int size, s16 x, u8 buttons) {
+	int xo = (size == 11) ? 0 : 1;
+
+	memset(r, 0, size);
+	r[xo + 0] = x & 0xff;
+	r[xo + 1] = (x >> 8) & 0xff;
+	r[size == 6 ? 0 : size == 11 ? 4 : 5] = buttons;
+}
+
+static void sim_keyboard_report(u8 *r, int size, int code) {
+	memset(r, 0, size);
+	if (!code)
+		return;
+	if (size == ASUS_MOUSE_KEYS_BITMASK_EVENT_SIZE)
+		r[2 + code / 8] |= 1 << (code % 8);
+	else
+		r[(size == 8) ? 2 : 3] = code;
+}
+
+/* stick at rest, so the joystick scrolling stays off */
+static void sim_gamepad_report(u8 *r, int size) {
+	int xo = (size == 5) ? 1 : 0;
+
+	memset(r, 0, size);
+	r[xo + 0] = 128;
+	r[xo + 1] = 128;
+}
+
+/* first mapped key which isn't a wheel key, it produces plain key frames */
+static int sim_plain_key(void) {
+	int code;
+
+	for (code = 1; code < ASUS_MOUSE_MAPPING_SIZE; code++)
+		if (asus_mouse_key_mapping[code] && !asus_mouse_is_wheel_key(asus_mouse_key_mapping[code]))
+			return code;
+	return 0;
+}
+
+static struct sim_report *sim_load(const char *path, size_t *count) {
+	struct sim_report *reports = NULL;
+	struct sim_interface *iface;
+	size_t capacity = 0;
+	char line[1024];
+	char *tok, *end;
+	u8 buf[SIM_REPORT_SIZE_MAX];
+	int size, lineno = 0;
+	unsigned long byte;
+	u32 application;
+	FILE *f;
+
+	f = fopen(path, "r");
+	if (!f) {
+		perror(path);
+		exit(1);
+	}
+
+	*count = 0;
+	while (fgets(line, sizeof(line), f)) {
+		lineno++;
+		tok = strtok(line, " \t\r\n");
+		if (!tok || tok[0] == '#')
+			continue;
+
+		if (!strcmp(tok, "mouse"))
+			application = HID_GD_MOUSE;
+		else if (!strcmp(tok, "keyboard"))
+			application = HID_GD_KEYBOARD;
+		else if (!strcmp(tok, "gamepad"))
+			application = HID_GD_GAMEPAD;
+		else {
+			fprintf(stderr, "%s:%d: unknown application '%s'\n", path, lineno, tok);
+			exit(1);
+		}
+
+		size = 0;
+		while ((tok = strtok(NULL, " \t\r\n"))) {
+			byte = strtoul(tok, &end, 16);
+			if (*end || byte > 0xff || size >= SIM_REPORT_SIZE_MAX) {
+				fprintf(stderr, "%s:%d: bad report byte '%s'\n", path, lineno, tok);
+				exit(1);
+			}
+			buf[size++] = byte;
+		}
+		if (!size)
+			continue;
+
+		/* an interface takes the length of its first report */
+		iface = sim_interface_find(application);
+		if (!iface) {
+			fprintf(stderr, "%s:%d: no %s interface\n", path, lineno, sim_app_name(application));
+			exit(1);
+		}
+		if (size != iface->size) {
+			fprintf(stderr, "%s:%d: %d bytes, the %s interface has %d\n",
+					path, lineno, size, sim_app_name(application), iface->size);
+			exit(1);
+		}
+
+		if (*count == capacity) {
+			capacity = capacity ? capacity * 2 : 1024;
+			reports = realloc(reports, capacity * sizeof(*reports));
+			if (!reports) {
+				perror("realloc");
+				exit(1);
+			}
+		}
+		reports[*count].iface = iface;
+		memcpy(reports[*count].data, buf, size);
+		(*count)++;
+	}
+
+	fclose(f);
+	return reports;
+}
+
+/* first report length of every application in a recorded stream */
+static void sim_scan(const char *path, int *mouse_size, int *keyboard_size, int *gamepad_size) {
+	char line[1024];
+	char *tok;
+	int *size, n;
+	FILE *f;
+
+	*mouse_size = *keyboard_size = *gamepad_size = 0;
+
+	f = fopen(path, "r");
+	if (!f) {
+		perror(path);
+		exit(1);
+	}
+
+	while (fgets(line, sizeof(line), f)) {
+		tok = strtok(line, " \t\r\n");
+		if (!tok || tok[0] == '#')
+			continue;
+		size = !strcmp(tok, "mouse") ? mouse_size :
+			!strcmp(tok, "keyboard") ? keyboard_size :
+			!strcmp(tok, "gamepad") ? gamepad_size : NULL;
+		if (!size || *size)
+			continue;
+		for (n = 0; strtok(NULL, " \t\r\n"); n++)
+			;
+		*size = n;
+	}
+
+	fclose(f);
+}
+
+/* read-only mapping of a capture ring, live from debugfs or a copy of it */
+static const struct asus_mouse_capture_header *sim_map_capture(const char *path, size_t *len) {
+	const struct asus_mouse_capture_header *header;
+	size_t page = sysconf(_SC_PAGESIZE);
+	struct stat st;
+	int fd;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0 || fstat(fd, &st)) {
+		perror(path);
+		exit(1);
+	}
+	if (st.st_size && (size_t)st.st_size < sizeof(*header)) {
+		fprintf(stderr, "%s: truncated capture\n", path);
+		exit(1);
+	}
+
+	/* debugfs files have no size, the header tells the size of the ring */
+	header = mmap(NULL, page, PROT_READ, MAP_SHARED, fd, 0);
+	if (header == MAP_FAILED) {
+		perror(path);
+		exit(1);
+	}
+	if (!asus_mouse_capture_valid(header, ~(size_t)0)) {
+		fprintf(stderr, "%s: not a capture ring of this driver version\n", path);
+		exit(1);
+	}
+
+	*len = header->records_offset + (u64)header->records * header->record_size;
+	munmap((void *)header, page);
+	if (st.st_size && (size_t)st.st_size < *len) {
+		fprintf(stderr, "%s: truncated capture\n", path);
+		exit(1);
+	}
+	header = mmap(NULL, *len, PROT_READ, MAP_SHARED, fd, 0);
+	if (header == MAP_FAILED) {
+		perror(path);
+		exit(1);
+	}
+
+	close(fd);
+	return header;
+}
+
+/* first report length of every application in a capture */
+static void sim_capture_scan(const struct asus_mouse_capture_header *header,
+		int *mouse_size, int *keyboard_size, int *gamepad_size) {
+	const struct asus_mouse_capture_record *rec;
+	u64 index, end;
+	int *size;
+
+	*mouse_size = *keyboard_size = *gamepad_size = 0;
+
+	for (index = asus_mouse_capture_range(header, &end); index < end; index++) {
+		rec = asus_mouse_capture_record(header, index);
+		size = rec->application == HID_GD_MOUSE ? mouse_size :
+			rec->application == HID_GD_KEYBOARD ? keyboard_size :
+			rec->application == HID_GD_GAMEPAD ? gamepad_size : NULL;
+		if (rec->seq == index + 1 && size && !*size && rec->size <= ASUS_MOUSE_CAPTURE_DATA_MAX)
+			*size = rec->size;
+	}
+}
+
+static struct sim_report *sim_capture_load(const struct asus_mouse_capture_header *header, size_t *count) {
+	const struct asus_mouse_capture_record *rec;
+	unsigned long lost = 0, skipped = 0;
+	struct sim_report *reports;
+	struct sim_interface *iface;
+	u64 index, end;
+
+	index = asus_mouse_capture_range(header, &end);
+	reports = calloc(end - index + 1, sizeof(*reports));
+	if (!reports) {
+		perror("calloc");
+		exit(1);
+	}
+
+	*count = 0;
+	for (; index < end; index++) {
+		rec = asus_mouse_capture_record(header, index);
+		if (__atomic_load_n(&rec->seq, __ATOMIC_ACQUIRE) != index + 1) {
+			lost++;
+			continue;
+		}
+
+		iface = sim_interface_find(rec->application);
+		if (!iface || rec->size != iface->size) {
+			skipped++;
+			continue;
+		}
+
+		reports[*count].iface = iface;
+		reports[*count].time_ns = rec->time_ns;
+		memcpy(reports[*count].data, rec->data, rec->size);
+
+		/* the driver may have overwritten the record while it was copied */
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (__atomic_load_n(&rec->seq, __ATOMIC_RELAXED) != index + 1) {
+			lost++;
+			continue;
+		}
+		(*count)++;
+	}
+
+	fprintf(stderr, "capture: %zu reports, %lu overwritten, %lu of other layouts\n",
+			*count, lost, skipped);
+	return reports;
+}
+
+static void sim_sleep_until(u64 ns) {
+	struct timespec ts = {
+		.tv_sec = ns / 1000000000ull,
+		.tv_nsec = ns % 1000000000ull,
+	};
+
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+		;
+}
+
+static int sim_cmp_u64(const void *a, const void *b) {
+	u64 x = *(const u64 *)a, y = *(const u64 *)b;
+
+	return (x > y) - (x < y);
+}
+
+static void sim_samples_print(const char *name, struct sim_samples *samples) {
+	double sum = 0;
+	size_t i;
+
+	if (!samples->num)
+		return;
+
+	qsort(samples->ns, samples->num, sizeof(*samples->ns), sim_cmp_u64);
+	for (i = 0; i < samples->num; i++)
+		sum += samples->ns[i];
+
+	printf("%s us: min %.1f, avg %.1f, p50 %.1f, p99 %.1f, max %.1f\n", name,
+		   samples->ns[0] / 1e3, sum / 1e3 / samples->num,
+		   samples->ns[samples->num / 2] / 1e3,
+		   samples->ns[samples->num * 99 / 100] / 1e3,
+		   samples->ns[samples->num - 1] / 1e3);
+}
+
+static void sim_print_results(u64 elapsed_ns, long motion_sent, bool synthetic) {
+	unsigned long reports = 0;
+	double seconds = elapsed_ns / 1e9;
+	size_t i;
+
+	printf("%-10s %5s %10s %12s %8s\n", "interface", "size", "reports", "reports/sec", "dropped");
+	for (i = 0; i < (size_t)sim_interfaces_num; i++) {
+		printf("%-10s %5d %10lu %12.0f %8ld\n", sim_app_name(sim_interfaces[i].application),
+			   sim_interfaces[i].size, sim_interfaces[i].sent, sim_interfaces[i].sent / seconds,
+			   sim_interface_dropped(&sim_interfaces[i]));
+		reports += sim_interfaces[i].sent;
+	}
+
+	printf("\nframes %lu (%.0f/sec), with motion %lu, evdev overflows %lu\n",
+		   sim_frames, sim_frames / seconds, sim_motion_frames, sim_syn_dropped);
+	printf("motion sent %ld, received %ld, lost %ld\n",
+		   motion_sent, sim_motion_received, motion_sent - sim_motion_received);
+
+	if (!synthetic || !sim_latency.num)
+		return;
+
+	printf("reports per motion frame %.2f\n", (double)sim_matched / sim_motion_frames);
+	sim_samples_print("latency", &sim_latency);
+	sim_samples_print("stamp offset", &sim_stamp_offset);
+	sim_samples_print("jitter", &sim_jitter);
+}
+
+static const struct sim_product *sim_product_find(const char *arg) {
+	unsigned long pid;
+	char *end;
+	size_t i;
+
+	pid = strtoul(arg, &end, 16);
+	for (i = 0; i < sizeof(sim_products) / sizeof(sim_products[0]); i++) {
+		if (!strcasecmp(arg, sim_products[i].name) || (!*end && pid == sim_products[i].product))
+			return &sim_products[i];
+	}
+
+	fprintf(stderr, "unknown product '%s', known ones:\n", arg);
+	for (i = 0; i < sizeof(sim_products) / sizeof(sim_products[0]); i++)
+		fprintf(stderr, "  %04x %s\n", sim_products[i].product, sim_products[i].name);
+	exit(1);
+}
+
+static void usage(const char *prog) {
+	fprintf(stderr,
+			"Usage: %s [-p product] [-f rate] [-n reports] [-m size] [-k size] [-g size] [-r recorded.txt] [-c capture] [-V] [-w seconds] [-b program.bpf.o] [-P product] [-v]\n"
+			"  -p  product ID in hex or name (default CHAKRAM_X_USB)\n"
+			"  -f  reports per second, up to %d (default 1000)\n"
+			"  -n  synthetic mouse reports (default 10000)\n"
+			"  -m  mouse report length, 6, 7 or 11 (default 7)\n"
+			"  -k  keyboard report length, 8, 9, 12 or 17, 0 for none (default 8)\n"
+			"  -g  gamepad report length, 4 or 5, 0 for none (default 4 for joystick products)\n"
+			"  -r  replay reports recorded from a device instead\n"
+			"  -c  replay the driver's capture ring or a copy of it instead, at its own pace unless -f is given\n"
+			"  -V  add a vendor interface answering configuration commands\n"
+			"  -w  print the HID devices and wait before sending, e.g. to attach HID-BPF programs\n"
+			"  -b  attach this HID-BPF normalizer to the interfaces and check what reached the driver\n"
+			"  -P  send the synthetic mouse reports through a second mouse of this product too,\n"
+			"      like the RF and USB paths of one mouse, with no keyboard and gamepad, and fail\n"
+			"      over to it with a button held\n"
+			"  -v  log requests of the driver\n", prog, SIM_RATE_MAX);
+	exit(1);
+}
+
+int main(int argc, char **argv) {
+	const struct sim_product *product = sim_product_find("CHAKRAM_X_USB"), *twin_product = NULL;
+	struct asus_mouse_decoder dec = { .caps = 0, .keymap = asus_mouse_key_mapping };
+	static struct asus_mouse_events evs;
+	struct sim_interface *mouse, *keyboard, *gamepad, *twin;
+	struct sim_report *reports = NULL;
+	int mouse_size = 7, keyboard_size = 8, gamepad_size = -1;
+	unsigned long rate = 1000, count = 10000, n;
+	const char *recorded = NULL, *captured = NULL, *bpf = NULL;
+	const struct asus_mouse_capture_header *capture = NULL;
+	struct sched_param sp = { .sched_priority = 1 };
+	bool replay, paced = false, vendor = false, failed = false;
+	long motion_sent = 0;
+	u64 start, period_ns, pause_ns;
+	size_t capture_len = 0;
+	pthread_t reader;
+	u8 buf[SIM_REPORT_SIZE_MAX];
+	size_t recorded_count = 0;
+	asus_mouse_decode_t mouse_decode = NULL;
+	int opt, key = 0, wait = 0;
+	unsigned int i, j;
+
+	while ((opt = getopt(argc, argv, "p:f:n:m:k:g:r:c:Vw:b:P:v")) != -1) {
+		switch(opt) {
+		case 'p':
+			product = sim_product_find(optarg);
+			break;
+		case 'f':
+			rate = strtoul(optarg, NULL, 0);
+			paced = true;
+			break;
+		case 'n':
+			count = strtoul(optarg, NULL, 0);
+			break;
+		case 'm':
+			mouse_size = atoi(optarg);
+			break;
+		case 'k':
+			keyboard_size = atoi(optarg);
+			break;
+		case 'g':
+			gamepad_size = atoi(optarg);
+			break;
+		case 'r':
+			recorded = optarg;
+			break;
+		case 'c':
+			captured = optarg;
+			break;
+		case 'V':
+			vendor = true;
+			break;
+		case 'w':
+			wait = atoi(optarg);
+			break;
+		case 'b':
+			bpf = optarg;
+			break;
+		case 'P':
+			twin_product = sim_product_find(optarg);
+			break;
+		case 'v':
+			sim_verbose = true;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+
+	if (!rate || rate > SIM_RATE_MAX || !count)
+		usage(argv[0]);
+
+	replay = recorded || captured;
+	/* the standby path decodes nothing, which the HID-BPF check would take for a loss */
+	if (twin_product && (replay || bpf))
+		usage(argv[0]);
+	if (twin_product) {
+		/* the driver links the paths by product, other interfaces would get in the way */
+		keyboard_size = 0;
+		gamepad_size = 0;
+	}
+	if (captured) {
+		capture = sim_map_capture(captured, &capture_len);
+		sim_capture_scan(capture, &mouse_size, &keyboard_size, &gamepad_size);
+	} else if (recorded)
+		sim_scan(recorded, &mouse_size, &keyboard_size, &gamepad_size);
+	else if (gamepad_size < 0)
+		gamepad_size = product->joystick ? 4 : 0;
+
+	if (mouse_size && asus_mouse_find_layout(HID_GD_MOUSE, mouse_size, 0))
+		mouse_decode = asus_mouse_find_layout(HID_GD_MOUSE, mouse_size, 0)->decode;
+
+	if ((mouse_size && !mouse_decode) ||
+			(keyboard_size && !asus_mouse_find_layout(HID_GD_KEYBOARD, keyboard_size, 0)) ||
+			(gamepad_size > 0 && !asus_mouse_find_layout(HID_GD_GAMEPAD, gamepad_size, ASUS_MOUSE_CAP_JOYSTICK)))
+		fprintf(stderr, "warning: the driver drops reports of unknown lengths\n");
+
+	mouse = mouse_size ? sim_interface_create(product, HID_GD_MOUSE, mouse_size) : NULL;
+	keyboard = keyboard_size ? sim_interface_create(product, HID_GD_KEYBOARD, keyboard_size) : NULL;
+	gamepad = gamepad_size > 0 ? sim_interface_create(product, HID_GD_GAMEPAD, gamepad_size) : NULL;
+	if (!mouse && !replay)
+		usage(argv[0]);
+	twin = twin_product ? sim_interface_create(twin_product, HID_GD_MOUSE, mouse_size) : NULL;
+	if (vendor)
+		sim_interface_create(product, SIM_VENDOR_APPLICATION, SIM_VENDOR_SIZE);
+
+	if (captured) {
+		reports = sim_capture_load(capture, &recorded_count);
+		munmap((void *)capture, capture_len);
+	} else if (recorded)
+		reports = sim_load(recorded, &recorded_count);
+
+	sim_inputs_open();
+
+	if (bpf) {
+		for (i = 0; i < (unsigned int)sim_interfaces_num; i++)
+			if (sim_interfaces[i].application != SIM_VENDOR_APPLICATION &&
+					!sim_bpf_attach(&sim_interfaces[i], bpf))
+				return 1;
+	}
+
+	if (wait > 0) {
+		for (i = 0; i < (unsigned int)sim_interfaces_num; i++)
+			printf("%s: /sys/bus/hid/devices/%s\n",
+				   sim_app_name(sim_interfaces[i].application), sim_interfaces[i].name);
+		printf("sending in %d s\n", wait);
+		fflush(stdout);
+		sleep(wait);
+	}
+
+	/* a best effort, the send schedule holds better with a realtime priority */
+	sched_setscheduler(0, SCHED_FIFO, &sp);
+
+	if (pthread_create(&reader, NULL, sim_reader, replay ? NULL : (void *)1)) {
+		perror("pthread_create");
+		return 1;
+	}
+
+	if (vendor && mouse && !sim_vendor_check(mouse))
+		failed = true;
+
+	period_ns = 1000000000ull / rate;
+	start = sim_now_ns();
+
+	n = replay ? recorded_count : count;
+	for (i = 0; i < n; i++) {
+		/* the first path goes quiet long enough for the twin to take over */
+		if (twin && i == n * 5 / 8) {
+			pause_ns = (sim_dedup_quiet_ms() + 50) * 1000000ull;
+			sim_sleep_until(sim_now_ns() + pause_ns);
+			start += pause_ns;
+		}
+
+		if (captured && !paced)
+			sim_sleep_until(start + reports[i].time_ns - reports[0].time_ns);
+		else
+			sim_sleep_until(start + (i + 1) * period_ns);
+
+		if (replay) {
+			/* the driver's own decoder tells the motion to expect */
+			if (reports[i].iface->application == HID_GD_MOUSE && mouse_decode) {
+				evs.count = 0;
+				mouse_decode(&dec, reports[i].data, &evs);
+				for (j = 0; j < evs.count; j++)
+					if (evs.ev[j].type == EV_REL && evs.ev[j].code == REL_X)
+						motion_sent += evs.ev[j].value;
+			}
+			sim_send(reports[i].iface, reports[i].data, reports[i].iface->size);
+			continue;
+		}
+
+		/* the side interfaces send between mouse reports, like a busy device */
+		if (keyboard && i % SIM_SIDE_TRAFFIC == SIM_SIDE_TRAFFIC / 2) {
+			key = key ? 0 : sim_plain_key();
+			sim_keyboard_report(buf, keyboard_size, key);
+			sim_send(keyboard, buf, keyboard_size);
+		}
+		if (gamepad && i % SIM_SIDE_TRAFFIC == 0) {
+			sim_gamepad_report(buf, gamepad_size);
+			sim_send(gamepad, buf, gamepad_size);
+		}
+
+		/* with a twin, the left button is held from the half up to the failover */
+		sim_mouse_report(buf, mouse_size, 1, twin && i >= n / 2 && i < n * 5 / 8);
+		sim_pending[sim_pending_head % SIM_PENDING_SIZE].sent_ns = sim_now_ns();
+		__atomic_store_n(&sim_pending_head, sim_pending_head + 1, __ATOMIC_RELEASE);
+		if (!twin || i < n * 5 / 8)
+			sim_send(mouse, buf, mouse_size);
+		if (twin)
+			sim_send(twin, buf, mouse_size);
+		motion_sent++;
+	}
+
+	/* coalesced frames and timer scrolls still come after the last report */
+	usleep(SIM_DRAIN_MS * 1000);
+	__atomic_store_n(&sim_stop, true, __ATOMIC_RELEASE);
+	pthread_join(reader, NULL);
+
+	sim_print_results(sim_now_ns() - start, motion_sent, !replay);
+
+	if (twin && !sim_keys_released())
+		failed = true;
+
+	if (bpf) {
+		for (i = 0; i < (unsigned int)sim_interfaces_num; i++)
+			if (!sim_bpf_check(&sim_interfaces[i]))
+				failed = true;
+		if (motion_sent != sim_motion_received) {
+			fprintf(stderr, "bpf: motion lost\n");
+			failed = true;
+		}
+	}
+
+	for (i = 0; i < (unsigned int)sim_interfaces_num; i++)
+		sim_interface_destroy(&sim_interfaces[i]);
+	free(reports);
+	free(sim_latency.ns);
+	free(sim_stamp_offset.ns);
+	free(sim_jitter.ns);
+	return failed;
+}
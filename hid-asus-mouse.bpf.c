@@ -0,0 +1,218 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * HID-BPF report normalizer for ASUS mice
+ *
+ * Copyright (c) 2022 Kyoken <kyoken@kyoken.ninja>
+ *
+ * Rewrites the reports of every layout the driver knows into one layout per
+ * application before they reach the driver:
+ *   mouse    6 and 11 bytes -> 7 bytes (X and Y at 1, buttons at 5, wheel at 6)
+ *   keyboard 8, 9 and 12 bytes -> 17 bytes (bitmask of key codes from 2 on)
+ *   gamepad  4 bytes -> 5 bytes (X and Y at 1)
+ * The driver picks the decoder of a report by its length every time it
+ * changes, so no descriptor fixup is needed. A report grows within the buffer
+ * HID-BPF allocated for the device, "allocated_size", and is left as it is
+ * if it doesn't fit.
+ *
+ * It's a template for new models: a layout the driver doesn't know yet is
+ * supported by rewriting it here into one of the above and adding the product
+ * to the driver through "new_id", with no module rebuild.
+ *
+ * Built with "make bpf" or by udev-hid-bpf and loaded with udev-hid-bpf, see
+ * the README.
+ */
+
+#include "vmlinux.h"
+#include "hid_bpf.h"
+#include "hid_bpf_helpers.h"
+#include <bpf/bpf_tracing.h>
+
+#define VID_ASUS 0x0b05
+
+#define ASUS_MOUSE_BPF_USB(pid) HID_DEVICE(BUS_USB, HID_GROUP_GENERIC, VID_ASUS, pid)
+
+HID_BPF_CONFIG(
+	ASUS_MOUSE_BPF_USB(0x1816),  /* ROG Buzzard */
+	ASUS_MOUSE_BPF_USB(0x18e5),  /* ROG Chakram RF */
+	ASUS_MOUSE_BPF_USB(0x18e3),  /* ROG Chakram USB */
+	HID_DEVICE(BUS_BLUETOOTH, HID_GROUP_GENERIC, VID_ASUS, 0x1a1c),  /* ROG Chakram X BT */
+	ASUS_MOUSE_BPF_USB(0x1a1a),  /* ROG Chakram X RF */
+	ASUS_MOUSE_BPF_USB(0x1a18),  /* ROG Chakram X USB */
+	ASUS_MOUSE_BPF_USB(0x1845),  /* ROG Gladius II */
+	ASUS_MOUSE_BPF_USB(0x18dd),  /* ROG Gladius II Core */
+	ASUS_MOUSE_BPF_USB(0x1877),  /* ROG Gladius II Origin, ROG Spatha X USB */
+	ASUS_MOUSE_BPF_USB(0x18cd),  /* ROG Gladius II Origin Pink */
+	ASUS_MOUSE_BPF_USB(0x197b),  /* ROG Gladius III */
+	ASUS_MOUSE_BPF_USB(0x197f),  /* ROG Gladius III Wireless */
+	ASUS_MOUSE_BPF_USB(0x1a70),  /* ROG Gladius III Wireless AimPoint RF */
+	ASUS_MOUSE_BPF_USB(0x1a72),  /* ROG Gladius III Wireless AimPoint USB */
+	ASUS_MOUSE_BPF_USB(0x1a68),  /* ROG Keris Wireless AimPoint RF */
+	ASUS_MOUSE_BPF_USB(0x1a66),  /* ROG Keris Wireless AimPoint USB */
+	ASUS_MOUSE_BPF_USB(0x1960),  /* ROG Keris Wireless RF */
+	ASUS_MOUSE_BPF_USB(0x195e),  /* ROG Keris Wireless USB */
+	ASUS_MOUSE_BPF_USB(0x1846),  /* ROG Pugio */
+	ASUS_MOUSE_BPF_USB(0x1906),  /* ROG Pugio II RF */
+	ASUS_MOUSE_BPF_USB(0x1908),  /* ROG Pugio II USB */
+	ASUS_MOUSE_BPF_USB(0x1824),  /* ROG Spatha RF */
+	ASUS_MOUSE_BPF_USB(0x181c),  /* ROG Spatha USB */
+	ASUS_MOUSE_BPF_USB(0x1879),  /* ROG Spatha X RF */
+	ASUS_MOUSE_BPF_USB(0x18b4),  /* ROG Strix Carry */
+	ASUS_MOUSE_BPF_USB(0x1847),  /* ROG Strix Impact */
+	ASUS_MOUSE_BPF_USB(0x1956),  /* ROG Strix Impact II Electro Punk */
+	ASUS_MOUSE_BPF_USB(0x1949),  /* ROG Strix Impact II Wireless RF */
+	ASUS_MOUSE_BPF_USB(0x1947),  /* ROG Strix Impact II Wireless USB */
+	ASUS_MOUSE_BPF_USB(0x1910),  /* TUF Gaming M3 */
+);
+
+#define ASUS_MOUSE_BPF_MOUSE 0x02  /* Generic Desktop usages of the applications */
+#define ASUS_MOUSE_BPF_GAMEPAD 0x05
+#define ASUS_MOUSE_BPF_KEYBOARD 0x06
+
+#define ASUS_MOUSE_BPF_MOUSE_SIZE 7
+#define ASUS_MOUSE_BPF_KEYBOARD_SIZE 17
+#define ASUS_MOUSE_BPF_GAMEPAD_SIZE 5
+#define ASUS_MOUSE_BPF_KEY_CODES 120  /* bits of the bitmask */
+
+/* application of the interface this copy of the program is attached to, set by probe() */
+__u8 application;
+
+static int asus_mouse_bpf_mouse(struct hid_bpf_ctx *hctx) {
+	__u8 btn, x0, x1, y0, y1, whl;
+	__u8 *data;
+
+	if (hctx->allocated_size < ASUS_MOUSE_BPF_MOUSE_SIZE)
+		return 0;
+	data = hid_bpf_get_data(hctx, 0, ASUS_MOUSE_BPF_MOUSE_SIZE);
+	if (!data)
+		return 0;
+
+	switch(hctx->size) {
+	case 6:  /* buttons at 0, X and Y at 1, wheel at 5 */
+		btn = data[0];
+		x0 = data[1]; x1 = data[2]; y0 = data[3]; y1 = data[4];
+		whl = data[5];
+		data[0] = 0;
+		break;
+	case 11:  /* X and Y at 0, buttons at 4, wheel at 5 */
+		x0 = data[0]; x1 = data[1]; y0 = data[2]; y1 = data[3];
+		btn = data[4];
+		whl = data[5];
+		data[0] = 0;
+		break;
+	default:
+		return 0;
+	}
+
+	data[1] = x0; data[2] = x1; data[3] = y0; data[4] = y1;
+	data[5] = btn;
+	data[6] = whl;
+	return ASUS_MOUSE_BPF_MOUSE_SIZE;
+}
+
+static int asus_mouse_bpf_keyboard(struct hid_bpf_ctx *hctx) {
+	unsigned int i, first, count;
+	__u8 codes[9];
+	__u8 *data;
+	__u8 code;
+
+	if (hctx->allocated_size < ASUS_MOUSE_BPF_KEYBOARD_SIZE)
+		return 0;
+	data = hid_bpf_get_data(hctx, 0, ASUS_MOUSE_BPF_KEYBOARD_SIZE);
+	if (!data)
+		return 0;
+
+	switch(hctx->size) {
+	case 8:  /* key codes from 2 on */
+		first = 2;
+		break;
+	case 9:  /* key codes from 3 on */
+	case 12:
+		first = 3;
+		break;
+	default:
+		return 0;
+	}
+
+	count = hctx->size - first;
+	for (i = 0; i < sizeof(codes); i++)
+		codes[i] = i < count ? data[first + i] : 0;
+
+	for (i = 1; i < ASUS_MOUSE_BPF_KEYBOARD_SIZE; i++)
+		data[i] = 0;
+	for (i = 0; i < sizeof(codes); i++) {
+		code = codes[i];
+		if (code && code < ASUS_MOUSE_BPF_KEY_CODES)
+			data[2 + (code >> 3)] |= 1 << (code & 7);
+	}
+
+	return ASUS_MOUSE_BPF_KEYBOARD_SIZE;
+}
+
+static int asus_mouse_bpf_gamepad(struct hid_bpf_ctx *hctx) {
+	__u8 *data;
+	__u8 x, y;
+
+	if (hctx->size != 4 || hctx->allocated_size < ASUS_MOUSE_BPF_GAMEPAD_SIZE)
+		return 0;
+	data = hid_bpf_get_data(hctx, 0, ASUS_MOUSE_BPF_GAMEPAD_SIZE);
+	if (!data)
+		return 0;
+
+	/* X and Y at 0 */
+	x = data[0];
+	y = data[1];
+	data[0] = 0;
+	data[1] = x;
+	data[2] = y;
+	data[3] = 0;
+	data[4] = 0;
+	return ASUS_MOUSE_BPF_GAMEPAD_SIZE;
+}
+
+SEC(HID_BPF_DEVICE_EVENT)
+int BPF_PROG(asus_mouse_bpf_event, struct hid_bpf_ctx *hctx) {
+	switch(application) {
+	case ASUS_MOUSE_BPF_MOUSE:
+		return asus_mouse_bpf_mouse(hctx);
+	case ASUS_MOUSE_BPF_KEYBOARD:
+		return asus_mouse_bpf_keyboard(hctx);
+	case ASUS_MOUSE_BPF_GAMEPAD:
+		return asus_mouse_bpf_gamepad(hctx);
+	default:
+		return 0;
+	}
+}
+
+HID_BPF_OPS(asus_mouse_bpf) = {
+	.hid_device_event = (void *)asus_mouse_bpf_event,
+};
+
+/*
+ * Attaches to the mouse, keyboard and gamepad interfaces only, found by the
+ * Usage Page (Generic Desktop), Usage and Collection (Application) their
+ * descriptors start with.
+ */
+SEC("syscall")
+int probe(struct hid_bpf_probe_args *ctx) {
+	const __u8 *rd = ctx->rdesc;
+
+	ctx->retval = -EINVAL;
+	if (ctx->rdesc_size < 6 || rd[0] != 0x05 || rd[1] != 0x01 || rd[2] != 0x09 ||
+			rd[4] != 0xa1 || rd[5] != 0x01)
+		return 0;
+
+	switch(rd[3]) {
+	case ASUS_MOUSE_BPF_MOUSE:
+	case ASUS_MOUSE_BPF_KEYBOARD:
+	case ASUS_MOUSE_BPF_GAMEPAD:
+		application = rd[3];
+		ctx->retval = 0;
+		break;
+	default:
+		break;
+	}
+
+	return 0;
+}
+
+char _license[] SEC("license") = "GPL";
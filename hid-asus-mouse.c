@@ -9,338 +9,2361 @@
 #include <linux/hid.h>
 #include <linux/usb.h>
 #include <linux/module.h>
-#include <linux/timer.h>
+#include <linux/hrtimer.h>
+#include <linux/math64.h>
+#include <linux/version.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/mutex.h>
+#include <linux/completion.h>
+#include <linux/workqueue.h>
+#include <linux/list.h>
+#include <linux/string.h>
+#include <linux/sysfs.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/mm.h>
+#include <linux/vmalloc.h>
+#include <linux/log2.h>
 
 /* #include "hid-ids.h" */
 #include "hid-asus-mouse.h"
 
+#define CREATE_TRACE_POINTS
+#include "hid-asus-mouse-trace.h"
+
+static bool per_device_input;
+module_param(per_device_input, bool, 0444);
+MODULE_PARM_DESC(per_device_input, "Create one virtual input device per physical mouse");
+
+static unsigned int scroll_period_us = ASUS_MOUSE_SCROLL_PERIOD_US;
+module_param(scroll_period_us, uint, 0644);
+MODULE_PARM_DESC(scroll_period_us, "Default emulated wheel tick in microseconds");
+
+static bool kinetic_scroll;
+module_param(kinetic_scroll, bool, 0644);
+MODULE_PARM_DESC(kinetic_scroll, "Default kinetic scrolling of the physical wheel");
+
+static unsigned int kinetic_friction = ASUS_MOUSE_KINETIC_FRICTION;
+module_param(kinetic_friction, uint, 0644);
+MODULE_PARM_DESC(kinetic_friction, "Default percent of the kinetic glide emitted every 16 ms");
+
+static unsigned int kinetic_gain = ASUS_MOUSE_KINETIC_GAIN;
+module_param(kinetic_gain, uint, 0644);
+MODULE_PARM_DESC(kinetic_gain, "Default percent of the wheel motion a kinetic glide emits");
+
+static unsigned int coalesce_rate_hz;
+module_param(coalesce_rate_hz, uint, 0644);
+MODULE_PARM_DESC(coalesce_rate_hz, "Default max rate of mouse motion frames, 0 to send every report");
+
+static unsigned int dedup_quiet_ms = ASUS_MOUSE_DEDUP_QUIET_MS;
+module_param(dedup_quiet_ms, uint, 0644);
+MODULE_PARM_DESC(dedup_quiet_ms,
+	"Quiet time of the active path of a mouse bound by RF and USB at once before the other takes over, 0 to decode both");
+
+static unsigned int capture_records;
+module_param(capture_records, uint, 0444);
+MODULE_PARM_DESC(capture_records, "Raw reports kept in the debugfs capture ring, 0 to disable it");
+
+static const struct asus_mouse_curve asus_mouse_default_curve = {
+	.type = ASUS_MOUSE_CURVE_LINEAR,
+	.points = 2,
+	.x = { 0, ASUS_MOUSE_KP_WHEEL_TIME_MS },
+	.y = { ASUS_MOUSE_KP_WHEEL_RES_MIN, ASUS_MOUSE_KP_WHEEL_RES_MAX },
+};
+
+static const struct asus_mouse_curve asus_mouse_default_joystick_curve = {
+	.type = ASUS_MOUSE_CURVE_LINEAR,
+	.points = 2,
+	.x = { 0, ASUS_MOUSE_JOYSTICK_OFFSET_MAX + 1 },
+	.y = { 0, ASUS_MOUSE_JOYSTICK_RES_MAX },
+};
+
+static const struct asus_mouse_curve asus_mouse_default_pointer_curve = {
+	.type = ASUS_MOUSE_CURVE_LINEAR,
+	.points = 2,
+	.x = { 0, ASUS_MOUSE_POINTER_SPEED_MAX },
+	.y = { ASUS_MOUSE_POINTER_GAIN, ASUS_MOUSE_POINTER_GAIN },
+};
+
+/* Buzzard, Gladius II and Gladius II Origin, and IDs added through "new_id" */
+static const struct asus_mouse_profile asus_mouse_profile_generic = {
+	.caps = ASUS_MOUSE_CAP_SIDE_BUTTONS,
+	.dpi_stages = 4,
+	.dpi_min = 100,
+	.dpi_max = 12000,
+	.dpi_step = 50,
+	.rates = 0xf,
+};
+
+static const struct asus_mouse_profile asus_mouse_profile_chakram = {
+	.caps = ASUS_MOUSE_CAP_SIDE_BUTTONS | ASUS_MOUSE_CAP_JOYSTICK,
+	.dpi_stages = 4,
+	.dpi_min = 100,
+	.dpi_max = 16000,
+	.dpi_step = 50,
+	.rates = 0xf,
+	.liftoff_levels = 2,
+};
+
+/* rates up to 8000 Hz through the RF receiver and the cable */
+static const struct asus_mouse_profile asus_mouse_profile_chakram_x = {
+	.caps = ASUS_MOUSE_CAP_SIDE_BUTTONS | ASUS_MOUSE_CAP_JOYSTICK,
+	.dpi_stages = 4,
+	.dpi_min = 100,
+	.dpi_max = 36000,
+	.dpi_step = 50,
+	.rates = 0x7f,
+	.liftoff_levels = 2,
+};
+
+/* no polling rate over Bluetooth */
+static const struct asus_mouse_profile asus_mouse_profile_chakram_x_bt = {
+	.caps = ASUS_MOUSE_CAP_SIDE_BUTTONS | ASUS_MOUSE_CAP_JOYSTICK,
+	.dpi_stages = 4,
+	.dpi_min = 100,
+	.dpi_max = 36000,
+	.dpi_step = 50,
+	.rates = 0,
+	.liftoff_levels = 2,
+};
+
+/* also Strix Impact II Electro Punk */
+static const struct asus_mouse_profile asus_mouse_profile_gladius2_core = {
+	.caps = ASUS_MOUSE_CAP_SIDE_BUTTONS,
+	.dpi_stages = 4,
+	.dpi_min = 100,
+	.dpi_max = 6200,
+	.dpi_step = 50,
+	.rates = 0xf,
+};
+
+/* also Spatha X */
+static const struct asus_mouse_profile asus_mouse_profile_gladius3 = {
+	.caps = ASUS_MOUSE_CAP_SIDE_BUTTONS,
+	.dpi_stages = 4,
+	.dpi_min = 100,
+	.dpi_max = 19000,
+	.dpi_step = 50,
+	.rates = 0xf,
+	.liftoff_levels = 2,
+};
+
+/* Gladius III and Keris Wireless AimPoint */
+static const struct asus_mouse_profile asus_mouse_profile_aimpoint = {
+	.caps = ASUS_MOUSE_CAP_SIDE_BUTTONS,
+	.dpi_stages = 4,
+	.dpi_min = 100,
+	.dpi_max = 36000,
+	.dpi_step = 50,
+	.rates = 0xf,
+	.liftoff_levels = 2,
+};
+
+/* also Pugio II and Strix Impact II Wireless */
+static const struct asus_mouse_profile asus_mouse_profile_keris = {
+	.caps = ASUS_MOUSE_CAP_SIDE_BUTTONS,
+	.dpi_stages = 4,
+	.dpi_min = 100,
+	.dpi_max = 16000,
+	.dpi_step = 50,
+	.rates = 0xf,
+	.liftoff_levels = 2,
+};
+
+/* also Strix Carry */
+static const struct asus_mouse_profile asus_mouse_profile_pugio = {
+	.caps = ASUS_MOUSE_CAP_SIDE_BUTTONS,
+	.dpi_stages = 4,
+	.dpi_min = 100,
+	.dpi_max = 7200,
+	.dpi_step = 50,
+	.rates = 0xf,
+};
+
+static const struct asus_mouse_profile asus_mouse_profile_spatha = {
+	.caps = ASUS_MOUSE_CAP_SIDE_BUTTONS,
+	.dpi_stages = 4,
+	.dpi_min = 100,
+	.dpi_max = 8200,
+	.dpi_step = 50,
+	.rates = 0xf,
+};
+
+static const struct asus_mouse_profile asus_mouse_profile_strix_impact = {
+	.caps = 0,
+	.dpi_stages = 4,
+	.dpi_min = 100,
+	.dpi_max = 5000,
+	.dpi_step = 50,
+	.rates = 0xf,
+};
+
+static const struct asus_mouse_profile asus_mouse_profile_tuf_m3 = {
+	.caps = ASUS_MOUSE_CAP_SIDE_BUTTONS,
+	.dpi_stages = 4,
+	.dpi_min = 100,
+	.dpi_max = 7000,
+	.dpi_step = 50,
+	.rates = 0xf,
+};
+
+/*
+ * Pairs are matched on product IDs alone, so each ID may belong to one model
+ * only. The Spatha X isn't paired, its USB ID 0x1877 is the Gladius II Origin
+ * too, which would be taken for the cable of any Spatha X receiver next to it.
+ */
+static const struct asus_mouse_pair asus_mouse_pairs[] = {
+	{ USB_DEVICE_ID_ASUSTEK_ROG_CHAKRAM_RF, USB_DEVICE_ID_ASUSTEK_ROG_CHAKRAM_USB },
+	{ USB_DEVICE_ID_ASUSTEK_ROG_CHAKRAM_X_RF, USB_DEVICE_ID_ASUSTEK_ROG_CHAKRAM_X_USB },
+	{ USB_DEVICE_ID_ASUSTEK_ROG_GLADIUS3_WIRELESS_AIMPOINT_RF,
+		USB_DEVICE_ID_ASUSTEK_ROG_GLADIUS3_WIRELESS_AIMPOINT_USB },
+	{ USB_DEVICE_ID_ASUSTEK_ROG_KERIS_WIRELESS_AIMPOINT_RF,
+		USB_DEVICE_ID_ASUSTEK_ROG_KERIS_WIRELESS_AIMPOINT_USB },
+	{ USB_DEVICE_ID_ASUSTEK_ROG_KERIS_WIRELESS_RF, USB_DEVICE_ID_ASUSTEK_ROG_KERIS_WIRELESS_USB },
+	{ USB_DEVICE_ID_ASUSTEK_ROG_PUGIO2_RF, USB_DEVICE_ID_ASUSTEK_ROG_PUGIO2_USB },
+	{ USB_DEVICE_ID_ASUSTEK_ROG_SPATHA_RF, USB_DEVICE_ID_ASUSTEK_ROG_SPATHA_USB },
+	{ USB_DEVICE_ID_ASUSTEK_ROG_STRIX_IMPACT2_WIRELESS_RF,
+		USB_DEVICE_ID_ASUSTEK_ROG_STRIX_IMPACT2_WIRELESS_USB },
+};
+
+static const struct asus_mouse_profile *const asus_mouse_profiles[] = {
+	&asus_mouse_profile_generic,
+	&asus_mouse_profile_chakram,
+	&asus_mouse_profile_chakram_x,
+	&asus_mouse_profile_chakram_x_bt,
+	&asus_mouse_profile_gladius2_core,
+	&asus_mouse_profile_gladius3,
+	&asus_mouse_profile_aimpoint,
+	&asus_mouse_profile_keris,
+	&asus_mouse_profile_pugio,
+	&asus_mouse_profile_spatha,
+	&asus_mouse_profile_strix_impact,
+	&asus_mouse_profile_tuf_m3,
+};
+
+static const char *const asus_mouse_curve_names[] = {
+	[ASUS_MOUSE_CURVE_LINEAR] = "linear",
+	[ASUS_MOUSE_CURVE_EXP] = "exp",
+	[ASUS_MOUSE_CURVE_CUSTOM] = "custom",
+};
+
+/* shared virtual input device, unless "per_device_input" is set */
 static struct input_dev *asus_mouse_input;
-static struct asus_mouse_state asus_mouse_state;
+static unsigned short asus_mouse_keymap[ASUS_MOUSE_MAPPING_SIZE];
+
+static LIST_HEAD(asus_mouse_device_list);
+static struct dentry *asus_mouse_debugfs_root;
+static DEFINE_MUTEX(asus_mouse_device_lock);  /* protects the list and "users" */
+static struct asus_mouse_capture_ring asus_mouse_capture;
+
+/* bucket i holds durations of [2^(i-1), 2^i) ns, bucket 0 holds zero */
+static void asus_mouse_hist_add(struct asus_mouse_hist *hist, s64 ns) {
+	unsigned int i = ns > 0 ? fls64(ns) : 0;
+
+	if (i >= ASUS_MOUSE_HIST_BUCKETS)
+		i = ASUS_MOUSE_HIST_BUCKETS - 1;
+	atomic_long_inc(&hist->bucket[i]);
+}
+
+static bool asus_mouse_scroll_active(struct asus_mouse_device *device) {
+	return device->repeat_key ||
+		asus_mouse_joystick_active(&device->joystick) ||
+		asus_mouse_kinetic_active(&device->kinetic);
+}
+
+static void asus_mouse_hrtimer_setup(
+		struct hrtimer *timer, enum hrtimer_restart (*function)(struct hrtimer *)) {
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 13, 0)
+	hrtimer_setup(timer, function, CLOCK_MONOTONIC, HRTIMER_MODE_REL_SOFT);
+#else
+	hrtimer_init(timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL_SOFT);
+	timer->function = function;
+#endif
+}
+
+/*
+ * Stamps the next frame of an input device with the time its events happened
+ * instead of the time it's synced. The input core drops the stamp at every sync.
+ */
+static void asus_mouse_set_timestamp(struct input_dev *input, ktime_t time) {
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 4, 0)
+	input_set_timestamp(input, time);
+#endif
+}
+
+static void asus_mouse_set_scroll_period(struct asus_mouse_device *device, unsigned int us) {
+	us = clamp_t(unsigned int, us, ASUS_MOUSE_SCROLL_PERIOD_US_MIN, ASUS_MOUSE_SCROLL_PERIOD_US_MAX);
+	device->scroll_period_us = us;
+	device->scroll_period = us_to_ktime(us);
+	asus_mouse_curve_build(&device->scroll_curve, us, &device->scroll_lut);
+	asus_mouse_joystick_build(&device->joystick, us);
+	asus_mouse_kinetic_build(&device->kinetic, us);
+}
+
+/* advances one axis by "amount" 16.16 hi-res units, keeping the fraction */
+static void asus_mouse_scroll_axis(
+		struct asus_mouse_device *device, unsigned int code, s32 *rem, s32 amount) {
+	s32 acc, step;
+
+	if (!amount)
+		return;
+
+	acc = *rem + amount;
+	step = acc >> 16;
+	*rem = acc - step * 65536;
+
+	if (step)
+		input_report_rel(device->input, code, step);
+}
+
+/* reports one tick of emulated wheel scrolling, the caller syncs the frame */
+static void asus_mouse_report_scroll(struct asus_mouse_device *device) {
+	s32 wheel_res = 0;
+	s32 wheel = 0, hwheel = 0;
+
+	if (device->repeat_key)
+		wheel_res = asus_mouse_curve_step(&device->scroll_lut, device->scroll_ticks);
+
+	switch(device->repeat_key) {
+	case KEY_KP4:
+		hwheel += wheel_res;
+		break;
+	case KEY_KP6:
+		hwheel -= wheel_res;
+		break;
+	case KEY_KP2:
+		wheel -= wheel_res;
+		break;
+	case KEY_KP8:
+		wheel += wheel_res;
+		break;
+	default:
+		break;
+	}
+
+	asus_mouse_joystick_tick(&device->joystick);
+	hwheel += asus_mouse_joystick_step(&device->joystick, 0);
+	wheel -= asus_mouse_joystick_step(&device->joystick, 1);
+	if (asus_mouse_kinetic_active(&device->kinetic))
+		wheel += asus_mouse_kinetic_step(&device->kinetic);
+
+	trace_asus_mouse_scroll_tick(device, wheel, hwheel);
+
+	asus_mouse_scroll_axis(device, REL_WHEEL_HI_RES, &device->scroll_rem[0], wheel);
+	asus_mouse_scroll_axis(device, REL_HWHEEL_HI_RES, &device->scroll_rem[1], hwheel);
+}
+
+/* called with "lock" held when scrolling starts */
+static void asus_mouse_start_scroll(struct asus_mouse_device *device) {
+	device->scroll_rem[0] = 0;
+	device->scroll_rem[1] = 0;
+	asus_mouse_report_scroll(device);
+	hrtimer_start(&device->scroll_timer, device->scroll_period, HRTIMER_MODE_REL_SOFT);
+}
+
+static enum hrtimer_restart asus_mouse_scroll_timer(struct hrtimer *timer) {
+	struct asus_mouse_device *device = container_of(timer, struct asus_mouse_device, scroll_timer);
+	enum hrtimer_restart ret = HRTIMER_NORESTART;
+	unsigned long flags;
+
+	this_cpu_inc(device->stats->scroll_timer);
+
+	spin_lock_irqsave(&device->lock, flags);
+	if (asus_mouse_scroll_active(device)) {
+		asus_mouse_hist_add(&device->scroll_lateness_hist,
+			ktime_to_ns(ktime_sub(hrtimer_cb_get_time(timer), hrtimer_get_expires(timer))));
+		/* the step belongs to the tick it was scheduled for, however late it runs */
+		asus_mouse_set_timestamp(device->input, hrtimer_get_expires(timer));
+		/* late ticks still count, so the curve follows the wall clock */
+		device->scroll_ticks += hrtimer_forward_now(timer, device->scroll_period);
+		asus_mouse_report_scroll(device);
+		input_sync(device->input);
+		ret = HRTIMER_RESTART;
+	}
+	spin_unlock_irqrestore(&device->lock, flags);
+
+	return ret;
+}
+
+#if LINUX_VERSION_CODE < KERNEL_VERSION(5, 11, 0)
+#define in_hardirq() in_irq()
+#endif
+
+/*
+ * Called with "lock" held, releases whatever the last macro left pressed.
+ * Returns true if it did, the caller then syncs once its frame is complete.
+ * A callback still running sees no macro and stops.
+ */
+static bool asus_mouse_stop_macro(struct asus_mouse_device *device) {
+	unsigned int code;
+	bool released = false;
+
+	device->macro = NULL;
+
+	for_each_set_bit(code, device->macro_keys, KEY_CNT) {
+		input_report_key(device->input, code, 0);
+		released = true;
+	}
+	bitmap_zero(device->macro_keys, KEY_CNT);
+	return released;
+}
+
+/*
+ * Starts a macro over the one playing, called without "lock" once the frame
+ * of its trigger is sent. A callback running on this CPU under a hard
+ * interrupt can't be waited for, it finds the timer queued again and leaves.
+ */
+static void asus_mouse_play_macro(struct asus_mouse_device *device, const struct asus_mouse_macro *macro) {
+	unsigned long flags;
+
+	if (in_hardirq())
+		hrtimer_try_to_cancel(&device->macro_timer);
+	else
+		hrtimer_cancel(&device->macro_timer);
+
+	spin_lock_irqsave(&device->lock, flags);
+	if (asus_mouse_stop_macro(device))
+		input_sync(device->input);
+	/* the slot may have been rewritten since the trigger */
+	if (macro->trigger && macro->steps) {
+		device->macro = macro;
+		device->macro_step = 0;
+		hrtimer_start(&device->macro_timer, us_to_ktime(macro->step[0].delay_us), HRTIMER_MODE_REL_SOFT);
+	}
+	spin_unlock_irqrestore(&device->lock, flags);
+}
+
+/*
+ * Plays the steps of one frame. Delays are added to the expiry time rather
+ * than to the callback time, so a late callback doesn't stretch the macro.
+ */
+static enum hrtimer_restart asus_mouse_macro_timer(struct hrtimer *timer) {
+	struct asus_mouse_device *device = container_of(timer, struct asus_mouse_device, macro_timer);
+	enum hrtimer_restart ret = HRTIMER_NORESTART;
+	const struct asus_mouse_macro_step *step;
+	const struct asus_mouse_macro *macro;
+	unsigned long flags;
+
+	spin_lock_irqsave(&device->lock, flags);
+	macro = device->macro;
+	/* stopped, or started again while this run waited for the lock */
+	if (!macro || hrtimer_is_queued(timer))
+		goto out;
+
+	do {
+		step = &macro->step[device->macro_step++];
+		input_event(device->input, step->type, step->code, step->value);
+		if (step->type == EV_KEY && step->value)
+			set_bit(step->code, device->macro_keys);
+		else if (step->type == EV_KEY)
+			clear_bit(step->code, device->macro_keys);
+	} while (device->macro_step < macro->steps && !macro->step[device->macro_step].delay_us);
+	asus_mouse_set_timestamp(device->input, hrtimer_get_expires(timer));
+	input_sync(device->input);
+
+	if (device->macro_step < macro->steps) {
+		hrtimer_add_expires_ns(timer, (u64)macro->step[device->macro_step].delay_us * NSEC_PER_USEC);
+		ret = HRTIMER_RESTART;
+	} else {
+		/* keys the macro keeps pressed are its own business until the next run */
+		device->macro = NULL;
+	}
+
+out:
+	spin_unlock_irqrestore(&device->lock, flags);
+	return ret;
+}
+
+/*
+ * Called with "lock" held, returns true if the key triggers a macro and is
+ * consumed. A macro to start is left in "play".
+ */
+static bool asus_mouse_macro_key(
+		struct asus_mouse_device *device, unsigned int code, s32 value, const struct asus_mouse_macro **play) {
+	unsigned int i;
+
+	for (i = 0; i < ASUS_MOUSE_MACROS_MAX; i++) {
+		if (device->macros[i].trigger != code)
+			continue;
+
+		/* a macro starts on the press only */
+		if (value && !test_and_set_bit(i, &device->macros_held))
+			*play = &device->macros[i];
+		else if (!value)
+			clear_bit(i, &device->macros_held);
+		return true;
+	}
+
+	return false;
+}
+
+/* sends the decoded events of a report, every frame stamped with the report's arrival */
+static void asus_mouse_emit(struct asus_mouse_data *drv_data, ktime_t time) {
+	struct asus_mouse_device *device = drv_data->device;
+	struct asus_mouse_events *evs = &drv_data->events;
+	const struct asus_mouse_macro *play = NULL;
+	struct asus_mouse_event *ev;
+	unsigned long flags;
+	bool stamp = true;
+	bool active;
+	unsigned int i;
+
+	if (!evs->count)
+		return;
+
+	spin_lock_irqsave(&device->lock, flags);
+	active = asus_mouse_scroll_active(device);
+
+	for (i = 0; i < evs->count; i++) {
+		ev = &evs->ev[i];
+
+		if ((ev->type == EV_KEY || ev->type == ASUS_MOUSE_EV_WHEEL_KEY) && ev->value == 1)
+			this_cpu_inc(drv_data->stats->key_presses);
+
+		switch(ev->type) {
+		case ASUS_MOUSE_EV_WHEEL_KEY:
+			if (ev->value) {
+				/* start repeating key events, first step goes into this frame */
+				device->repeat_key = ev->code;
+				device->scroll_ticks = 0;
+				if (!active)
+					asus_mouse_start_scroll(device);
+				active = true;
+			} else {
+				/* stop repeating key events */
+				device->repeat_key = 0;
+			}
+			continue;
+		case ASUS_MOUSE_EV_JOYSTICK:
+			asus_mouse_joystick_input(&device->joystick, ev->code == ABS_X ? 0 : 1, ev->value);
+			continue;
+		case EV_REL:
+			if (ev->code == REL_WHEEL_HI_RES && device->kinetic_scroll) {
+				/* wheel motion glides, first step goes into this frame */
+				if (ev->value) {
+					asus_mouse_kinetic_push(&device->kinetic, ev->value);
+					if (!active)
+						asus_mouse_start_scroll(device);
+					active = true;
+				}
+				continue;
+			}
+			break;
+		case EV_KEY:
+			if (device->macros_num && asus_mouse_macro_key(device, ev->code, ev->value, &play))
+				continue;
+			__assign_bit(ev->code, device->keys_down, ev->value);
+			break;
+		}
+
+		/*
+		 * stamped on the first event reported since the last sync, the sync
+		 * clears it, so frames that report nothing leave no stamp behind
+		 */
+		if (stamp && ev->type != EV_SYN)
+			asus_mouse_set_timestamp(drv_data->input, time);
+		stamp = ev->type == EV_SYN;
+		input_event(drv_data->input, ev->type, ev->code, ev->value);
+	}
+
+	/* joystick left its center, start scrolling right away */
+	if (!active && asus_mouse_scroll_active(device)) {
+		asus_mouse_start_scroll(device);
+		input_sync(device->input);
+	}
+
+	spin_unlock_irqrestore(&device->lock, flags);
+	evs->count = 0;
+
+	/* the frames of a macro follow the frame of its trigger */
+	if (unlikely(play))
+		asus_mouse_play_macro(device, play);
+}
+
+static void asus_mouse_set_coalesce_rate(struct asus_mouse_device *device, unsigned int hz) {
+	if (hz)
+		hz = clamp_t(unsigned int, hz, ASUS_MOUSE_COALESCE_RATE_HZ_MIN, ASUS_MOUSE_COALESCE_RATE_HZ_MAX);
+	device->coalesce_rate_hz = hz;
+	device->coalesce_period = hz ? ns_to_ktime(div_u64(NSEC_PER_SEC, hz)) : 0;
+}
+
+/*
+ * Adds the motion of a decoded mouse report to the pending frame. The report
+ * goes out with all the motion merged so far on a button edge or once the
+ * output period has passed, otherwise it's dropped and the coalescing timer
+ * sends the frame when the period ends.
+ */
+static void asus_mouse_coalesce(struct asus_mouse_data *drv_data, ktime_t now) {
+	struct asus_mouse_device *device = drv_data->device;
+	struct asus_mouse_events *evs = &drv_data->events;
+	struct asus_mouse_event *ev;
+	unsigned long flags;
+	unsigned int i;
+	bool flush;
+
+	spin_lock_irqsave(&device->lock, flags);
+	if (!device->coalesce_rate_hz && !device->coalesce_pending)
+		goto out;
+
+	flush = !device->coalesce_rate_hz || ktime_compare(now, device->coalesce_next) >= 0;
+
+	for (i = 0; i < evs->count; i++) {
+		ev = &evs->ev[i];
+		if (ev->type == EV_KEY) {
+			/* clicks never wait, the decoder only sends button edges */
+			flush = true;
+		} else if (ev->type == EV_REL) {
+			device->coalesce_rel[ev->code] += ev->value;
+		}
+	}
+
+	if (!flush) {
+		evs->count = 0;
+		device->coalesce_last = now;
+		this_cpu_inc(device->stats->coalesce_merged);
+		if (!device->coalesce_pending) {
+			device->coalesce_pending = true;
+			hrtimer_start(&device->coalesce_timer, device->coalesce_next, HRTIMER_MODE_ABS_SOFT);
+		}
+		goto out;
+	}
+
+	for (i = 0; i < evs->count; i++) {
+		ev = &evs->ev[i];
+		if (ev->type == EV_REL) {
+			ev->value = device->coalesce_rel[ev->code];
+			device->coalesce_rel[ev->code] = 0;
+		}
+	}
+
+	/* the timer takes the lock too, it finds nothing pending if it's already running */
+	if (device->coalesce_pending) {
+		device->coalesce_pending = false;
+		hrtimer_try_to_cancel(&device->coalesce_timer);
+	}
+	device->coalesce_next = ktime_add(now, device->coalesce_period);
+	this_cpu_inc(device->stats->coalesce_frames);
+
+out:
+	spin_unlock_irqrestore(&device->lock, flags);
+}
+
+static enum hrtimer_restart asus_mouse_coalesce_timer(struct hrtimer *timer) {
+	struct asus_mouse_device *device = container_of(timer, struct asus_mouse_device, coalesce_timer);
+	unsigned long flags;
+	unsigned int code;
+	bool scrolling;
+	s32 value;
+
+	spin_lock_irqsave(&device->lock, flags);
+	if (device->coalesce_pending) {
+		for (code = 0; code < REL_CNT; code++) {
+			value = device->coalesce_rel[code];
+			if (!value)
+				continue;
+			device->coalesce_rel[code] = 0;
+
+			if (code == REL_WHEEL_HI_RES && device->kinetic_scroll) {
+				scrolling = asus_mouse_scroll_active(device);
+				asus_mouse_kinetic_push(&device->kinetic, value);
+				if (!scrolling)
+					asus_mouse_start_scroll(device);
+			} else {
+				input_report_rel(device->input, code, value);
+			}
+		}
+		/* the frame carries motion up to the last merged report */
+		asus_mouse_set_timestamp(device->input, device->coalesce_last);
+		input_sync(device->input);
+
+		device->coalesce_pending = false;
+		device->coalesce_next = ktime_add(ktime_get(), device->coalesce_period);
+		this_cpu_inc(device->stats->coalesce_frames);
+	}
+	spin_unlock_irqrestore(&device->lock, flags);
+
+	return HRTIMER_NORESTART;
+}
+
+static void asus_mouse_count_report(
+		struct asus_mouse_stats __percpu *stats, unsigned int application, int size) {
+	switch(application) {
+	case HID_GD_MOUSE:
+		this_cpu_inc(stats->reports_mouse);
+		break;
+	case HID_GD_KEYBOARD:
+		this_cpu_inc(stats->reports_keyboard);
+		break;
+	case HID_GD_GAMEPAD:
+		this_cpu_inc(stats->reports_gamepad);
+		break;
+	default:
+		this_cpu_inc(stats->reports_other);
+		break;
+	}
+
+	this_cpu_inc(stats->reports_size[min(size, ASUS_MOUSE_STATS_SIZES - 1)]);
+}
+
+/*
+ * Lock-free, any number of interfaces write at once: the index reserves
+ * a record, "seq" tells readers when it is complete.
+ */
+static void asus_mouse_capture_add(
+		struct hid_device *hdev, struct hid_report *report, const u8 *data, int size, ktime_t time) {
+	struct asus_mouse_capture_record *rec;
+	u64 index;
+
+	index = atomic64_inc_return(&asus_mouse_capture.next) - 1;
+	rec = &asus_mouse_capture.records[index & asus_mouse_capture.mask];
+
+	WRITE_ONCE(rec->seq, 0);
+	smp_wmb();
+
+	rec->time_ns = ktime_to_ns(time);
+	rec->application = report->application;
+	rec->hid = hdev->id;
+	rec->product = hdev->product;
+	rec->id = report->id;
+	rec->size = size;
+	memcpy(rec->data, data, min(size, ASUS_MOUSE_CAPTURE_DATA_MAX));
+
+	smp_store_release(&rec->seq, index + 1);
+}
+
+/* completes the command waiting for this answer, other reports are ignored */
+static void asus_mouse_vendor_answer(
+		struct asus_mouse_device *device, struct hid_report *report, const u8 *data, int size) {
+	int off = report->id ? 1 : 0;
+	u16 cmd = READ_ONCE(device->vendor_cmd);
+
+	if (cmd && size >= off + 2 && get_unaligned_le16(data + off) == cmd)
+		complete(&device->vendor_done);
+}
+
+/* sends one command and waits for its answer, called with "vendor_lock" held */
+static int asus_mouse_vendor_command(struct asus_mouse_device *device, u16 cmd, u8 field, u16 value) {
+	struct hid_report *report = device->vendor_report;
+	int len, off, ret;
+	u8 *buf;
+
+	len = hid_report_len(report);
+	off = report->id ? 1 : 0;
+	buf = kzalloc(len, GFP_KERNEL);  /* transfer buffers can't live on the stack */
+	if (!buf)
+		return -ENOMEM;
+
+	/*
+	 * the whole report is sent: the ID byte first for a numbered report, then
+	 * the command, field and value, zero padded. An unnumbered report has no
+	 * ID byte and starts with the command, whose low byte is never 0, so
+	 * usbhid doesn't take it for a report ID of 0 and strip it.
+	 */
+	buf[0] = report->id;
+	put_unaligned_le16(cmd, buf + off);
+	buf[off + 2] = field;
+	put_unaligned_le16(value, buf + off + 4);
+
+	reinit_completion(&device->vendor_done);
+	WRITE_ONCE(device->vendor_cmd, cmd);
+	this_cpu_inc(device->stats->vendor_commands);
+
+	ret = hid_hw_output_report(device->vendor, buf, len);
+	if (ret == -ENOSYS)
+		ret = hid_hw_raw_request(device->vendor, report->id, buf, len,
+			HID_OUTPUT_REPORT, HID_REQ_SET_REPORT);
+	kfree(buf);
+
+	if (ret >= 0 && !wait_for_completion_timeout(&device->vendor_done,
+			msecs_to_jiffies(ASUS_MOUSE_VENDOR_TIMEOUT_MS))) {
+		this_cpu_inc(device->stats->vendor_timeouts);
+		ret = -ETIMEDOUT;
+	}
+
+	WRITE_ONCE(device->vendor_cmd, 0);
+	return ret < 0 ? ret : 0;
+}
+
+/* sends a command until it's answered, called with "vendor_lock" held */
+static int asus_mouse_vendor_send(struct asus_mouse_device *device, u16 cmd, u8 field, u16 value) {
+	unsigned int retry;
+	int ret;
+
+	for (retry = 0; ; retry++) {
+		ret = asus_mouse_vendor_command(device, cmd, field, value);
+		if (!ret || retry == ASUS_MOUSE_VENDOR_RETRIES)
+			break;
+		this_cpu_inc(device->stats->vendor_retries);
+	}
+
+	if (ret) {
+		this_cpu_inc(device->stats->vendor_failed);
+		hid_err(device->vendor, "%s: command 0x%04x field %u failed with error %d\n",
+				__func__, cmd, field, ret);
+	}
+	return ret;
+}
+
+/*
+ * Sends the dirty settings one by one and stores them in the mouse once they
+ * are all sent. Settings written meanwhile are picked up by the same run,
+ * the ones left when the vendor interface goes away wait for the next one.
+ */
+static void asus_mouse_vendor_work(struct work_struct *work) {
+	struct asus_mouse_device *device = container_of(work, struct asus_mouse_device, vendor_work);
+	unsigned long flags;
+	unsigned int field;
+	bool sent = false;
+	u16 value;
+
+	for (;;) {
+		mutex_lock(&device->vendor_lock);
+		if (!device->vendor) {
+			mutex_unlock(&device->vendor_lock);
+			return;
+		}
+
+		spin_lock_irqsave(&device->lock, flags);
+		if (!device->vendor_dirty) {
+			spin_unlock_irqrestore(&device->lock, flags);
+			break;
+		}
+		field = __ffs(device->vendor_dirty);
+		__clear_bit(field, &device->vendor_dirty);
+		value = device->vendor_values[field];
+		spin_unlock_irqrestore(&device->lock, flags);
+
+		if (!asus_mouse_vendor_send(device, ASUS_MOUSE_CMD_SET_SETTING, field, value))
+			sent = true;
+		mutex_unlock(&device->vendor_lock);
+	}
+
+	if (sent)
+		asus_mouse_vendor_send(device, ASUS_MOUSE_CMD_SAVE, 0, 0);
+	mutex_unlock(&device->vendor_lock);
+}
+
+/* marks a setting dirty, a value still waiting to be sent is replaced */
+static void asus_mouse_vendor_queue(struct asus_mouse_device *device, unsigned int field, u16 value) {
+	unsigned long flags;
+
+	spin_lock_irqsave(&device->lock, flags);
+	if (test_bit(field, &device->vendor_dirty))
+		this_cpu_inc(device->stats->vendor_merged);
+	__set_bit(field, &device->vendor_dirty);
+	device->vendor_values[field] = value;
+	spin_unlock_irqrestore(&device->lock, flags);
+
+	queue_work(system_long_wq, &device->vendor_work);
+}
+
+/* output report of the vendor interface, NULL for the other interfaces */
+static struct hid_report *asus_mouse_find_vendor_report(struct hid_device *hdev) {
+	struct hid_report_enum *report_enum = &hdev->report_enum[HID_OUTPUT_REPORT];
+	struct hid_report *report;
+
+	list_for_each_entry(report, &report_enum->report_list, list) {
+		if ((report->application >> 16) == ASUS_MOUSE_VENDOR_PAGE &&
+				hid_report_len(report) >= ASUS_MOUSE_VENDOR_CMD_SIZE + (report->id ? 1 : 0))
+			return report;
+	}
+
+	return NULL;
+}
+
+/*
+ * The reports of a path that lost won't release what it holds anymore, so
+ * it's released now, and its scrolling stops.
+ */
+static void asus_mouse_release_path(struct asus_mouse_device *device) {
+	unsigned long flags;
+	unsigned int code;
+	bool released = false;
+
+	spin_lock_irqsave(&device->lock, flags);
+	for_each_set_bit(code, device->keys_down, KEY_CNT) {
+		input_report_key(device->input, code, 0);
+		released = true;
+	}
+	bitmap_zero(device->keys_down, KEY_CNT);
+	device->macros_held = 0;
+	device->repeat_key = 0;
+	memset(device->joystick.target, 0, sizeof(device->joystick.target));
+	memset(device->joystick.pos, 0, sizeof(device->joystick.pos));
+	if (released)
+		input_sync(device->input);
+	spin_unlock_irqrestore(&device->lock, flags);
+}
+
+/*
+ * Returns false for the reports of the standby path of a mouse bound twice.
+ * The first path to report once the active one has been quiet for
+ * "dedup_quiet_ms" becomes the active one, so a lost path fails over and
+ * the paths of an idle mouse don't matter. The path that lost is released,
+ * the one taking over gets a new "path_epoch" and its interfaces start over
+ * from an empty decoder state.
+ */
+static bool asus_mouse_dedup(struct asus_mouse_device *device, u64 now) {
+	struct asus_mouse_device *peer, *link, *active;
+	bool pass = true;
+	u64 quiet;
+
+	quiet = (u64)READ_ONCE(dedup_quiet_ms) * NSEC_PER_MSEC;
+
+	rcu_read_lock();
+	peer = rcu_dereference(device->peer);
+	if (peer && quiet) {
+		link = device->link_usb ? device : peer;
+		active = READ_ONCE(link->link_active);
+		if (active != device) {
+			/* the other path may have stamped its report after "now" was taken */
+			if (active && (s64)(now - READ_ONCE(active->last_report_ns)) < (s64)quiet) {
+				pass = false;
+			} else if (cmpxchg(&link->link_active, active, device) != active) {
+				pass = false;  /* the other path has just taken over */
+			} else {
+				WRITE_ONCE(device->path_epoch, device->path_epoch + 1);
+				if (active)
+					asus_mouse_release_path(active);
+				this_cpu_inc(device->stats->path_switches);
+			}
+		}
+	}
+	rcu_read_unlock();
+
+	if (pass)
+		WRITE_ONCE(device->last_report_ns, now);
+	return pass;
+}
+
+/* scales and accelerates the motion of a mouse report, if the settings aren't neutral */
+static void asus_mouse_pointer(struct asus_mouse_data *drv_data) {
+	struct asus_mouse_device *device = drv_data->device;
+	struct asus_mouse_events *evs = &drv_data->events;
+	s32 *x = NULL, *y = NULL;
+	unsigned long flags;
+	unsigned int i;
+
+	if (!READ_ONCE(device->pointer.active))
+		return;
+
+	for (i = 0; i < evs->count; i++) {
+		if (evs->ev[i].type != EV_REL)
+			continue;
+		if (evs->ev[i].code == REL_X)
+			x = &evs->ev[i].value;
+		else if (evs->ev[i].code == REL_Y)
+			y = &evs->ev[i].value;
+	}
+	if (!x || !y)
+		return;
+
+	spin_lock_irqsave(&device->lock, flags);
+	asus_mouse_pointer_apply(&device->pointer, x, y);
+	spin_unlock_irqrestore(&device->lock, flags);
+}
+
+/*
+ * A HID-BPF program may rewrite reports into another layout the driver knows,
+ * so a report of an unexpected length gets the decoder of its new length.
+ */
+static bool asus_mouse_resize_report(
+		struct asus_mouse_data *drv_data, struct asus_mouse_report *entry, int size) {
+	const struct asus_mouse_layout *layout;
+
+	if (!entry->application)
+		return false;
+
+	layout = asus_mouse_find_layout(entry->application, size, drv_data->decoder.caps);
+	if (!layout)
+		return false;
+
+	entry->decode = layout->decode;
+	entry->size = size;
+	return true;
+}
+
+/* decoded events of one report, only walked while their tracepoint is enabled */
+static void asus_mouse_trace_events(
+		struct hid_device *hdev, unsigned int application, const struct asus_mouse_events *evs) {
+	const struct asus_mouse_event *ev;
+	unsigned int i;
+
+	switch(application) {
+	case HID_GD_MOUSE:
+		if (!trace_asus_mouse_mouse_enabled())
+			return;
+		break;
+	case HID_GD_KEYBOARD:
+		if (!trace_asus_mouse_key_enabled())
+			return;
+		break;
+	case HID_GD_GAMEPAD:
+		if (!trace_asus_mouse_joystick_enabled())
+			return;
+		break;
+	default:
+		return;
+	}
+
+	for (i = 0; i < evs->count; i++) {
+		ev = &evs->ev[i];
+		if (ev->type == EV_SYN)
+			continue;
+
+		switch(application) {
+		case HID_GD_MOUSE:
+			trace_asus_mouse_mouse(hdev, ev);
+			break;
+		case HID_GD_KEYBOARD:
+			trace_asus_mouse_key(hdev, ev);
+			break;
+		default:
+			trace_asus_mouse_joystick(hdev, ev);
+			break;
+		}
+	}
+}
+
+static int asus_mouse_raw_event(
+		struct hid_device *hdev, struct hid_report *report, u8 *data, int size) {
+	struct asus_mouse_data *drv_data = hid_get_drvdata(hdev);
+	u32 key_state[ASUS_MOUSE_DATA_KEY_STATE_NUM];
+	struct asus_mouse_report *entry;
+	unsigned int epoch;
+	bool trace_keys;
+	ktime_t start;
+
+	if (!drv_data)
+		return 0;
+
+	start = ktime_get();
+	asus_mouse_count_report(drv_data->stats, report->application, size);
+	if (unlikely(asus_mouse_capture.records))
+		asus_mouse_capture_add(hdev, report, data, size, start);
+
+	trace_asus_mouse_raw_event(hdev, report, data, size);
+
+	if (unlikely(hdev == READ_ONCE(drv_data->device->vendor)) &&
+			(report->application >> 16) == ASUS_MOUSE_VENDOR_PAGE) {
+		asus_mouse_vendor_answer(drv_data->device, report, data, size);
+		return 0;
+	}
+
+	if (unlikely(rcu_access_pointer(drv_data->device->peer))) {
+		if (!asus_mouse_dedup(drv_data->device, ktime_to_ns(start))) {
+			this_cpu_inc(drv_data->stats->suppressed);
+			return 0;
+		}
+		/* what the decoder holds is from before the path lost, or was released since */
+		epoch = READ_ONCE(drv_data->device->path_epoch);
+		if (unlikely(drv_data->path_epoch != epoch)) {
+			memset(drv_data->decoder.key_state, 0, sizeof(drv_data->decoder.key_state));
+			drv_data->decoder.buttons = 0;
+			drv_data->path_epoch = epoch;
+		}
+	}
+
+	entry = &drv_data->reports[report->id];
+	if (unlikely(size != entry->size) && !asus_mouse_resize_report(drv_data, entry, size)) {
+		if (entry->application)
+			this_cpu_inc(drv_data->stats->dropped);
+		return 0;
+	}
+
+	trace_keys = entry->application == HID_GD_KEYBOARD && trace_asus_mouse_key_state_enabled();
+	if (trace_keys)
+		memcpy(key_state, drv_data->decoder.key_state, sizeof(key_state));
+
+	entry->decode(&drv_data->decoder, data, &drv_data->events);
+
+	if (trace_keys)
+		trace_asus_mouse_key_state(hdev, key_state, drv_data->decoder.key_state);
+	asus_mouse_trace_events(hdev, entry->application, &drv_data->events);
+	if (entry->application == HID_GD_MOUSE) {
+		if (drv_data->last_report)
+			asus_mouse_hist_add(&drv_data->device->report_interval_hist,
+				ktime_to_ns(ktime_sub(start, drv_data->last_report)));
+		drv_data->last_report = start;
+		asus_mouse_pointer(drv_data);
+		asus_mouse_coalesce(drv_data, start);
+	}
+	asus_mouse_emit(drv_data, start);
+
+	asus_mouse_hist_add(&drv_data->device->raw_event_hist, ktime_to_ns(ktime_sub(ktime_get(), start)));
+
+	return 0;
+}
+
+static ssize_t scroll_period_us_show(struct device *dev, struct device_attribute *attr, char *buf) {
+	struct asus_mouse_data *drv_data = dev_get_drvdata(dev);
+
+	return sysfs_emit(buf, "%u\n", drv_data->device->scroll_period_us);
+}
+
+static ssize_t scroll_period_us_store(
+		struct device *dev, struct device_attribute *attr, const char *buf, size_t count) {
+	struct asus_mouse_data *drv_data = dev_get_drvdata(dev);
+	struct asus_mouse_device *device = drv_data->device;
+	unsigned long flags;
+	unsigned int us;
+	int ret;
+
+	ret = kstrtouint(buf, 0, &us);
+	if (ret)
+		return ret;
+	if (us < ASUS_MOUSE_SCROLL_PERIOD_US_MIN || us > ASUS_MOUSE_SCROLL_PERIOD_US_MAX)
+		return -EINVAL;
+
+	spin_lock_irqsave(&device->lock, flags);
+	asus_mouse_set_scroll_period(device, us);
+	spin_unlock_irqrestore(&device->lock, flags);
+
+	return count;
+}
+static DEVICE_ATTR_RW(scroll_period_us);
+
+static ssize_t asus_mouse_show_curve(char *buf, const struct asus_mouse_curve *curve) {
+	unsigned int i;
+	int len;
+
+	len = sysfs_emit(buf, "%s", asus_mouse_curve_names[curve->type]);
+	if (curve->type == ASUS_MOUSE_CURVE_CUSTOM) {
+		for (i = 0; i < curve->points; i++)
+			len += sysfs_emit_at(buf, len, " %u:%u", curve->x[i], curve->y[i]);
+	} else {
+		len += sysfs_emit_at(buf, len, " %u %u %u", curve->y[0], curve->y[1], curve->x[1]);
+	}
+	len += sysfs_emit_at(buf, len, "\n");
+
+	return len;
+}
+
+/*
+ * "linear <min> <max> <x>" and "exp <min> <max> <x>" ramp from <min> to <max>
+ * over the input range 0...<x>, "custom <x>:<y> ..." goes through up to 8 points
+ * with strictly increasing inputs.
+ */
+static int asus_mouse_parse_curve(char *str, struct asus_mouse_curve *curve) {
+	char *token, *value;
+	unsigned int i;
+	int ret;
+
+	token = strsep(&str, " \t\n");
+	for (i = 0; i < ARRAY_SIZE(asus_mouse_curve_names); i++)
+		if (token && !strcmp(token, asus_mouse_curve_names[i]))
+			break;
+	if (i == ARRAY_SIZE(asus_mouse_curve_names))
+		return -EINVAL;
+
+	curve->type = i;
+	curve->points = 0;
+
+	if (curve->type != ASUS_MOUSE_CURVE_CUSTOM) {
+		if (!str || sscanf(str, "%u %u %u", &curve->y[0], &curve->y[1], &curve->x[1]) != 3)
+			return -EINVAL;
+		curve->x[0] = 0;
+		curve->points = 2;
+	} else {
+		while ((token = strsep(&str, " \t\n"))) {
+			if (!*token)
+				continue;
+			if (curve->points == ASUS_MOUSE_CURVE_POINTS_MAX)
+				return -E2BIG;
+
+			value = strchr(token, ':');
+			if (!value)
+				return -EINVAL;
+			*value++ = '\0';
+
+			ret = kstrtou32(token, 10, &curve->x[curve->points]);
+			if (!ret)
+				ret = kstrtou32(value, 10, &curve->y[curve->points]);
+			if (ret)
+				return ret;
+			curve->points++;
+		}
+	}
+
+	if (!curve->points)
+		return -EINVAL;
+
+	for (i = 0; i < curve->points; i++) {
+		if (curve->y[i] > ASUS_MOUSE_CURVE_Y_MAX ||
+				curve->x[i] > ASUS_MOUSE_CURVE_X_MAX ||
+				(i && curve->x[i] <= curve->x[i - 1]))
+			return -EINVAL;
+	}
+
+	return 0;
+}
+
+/* scroll speed in hi-res units per 16 ms over the time in ms a wheel key is held */
+static ssize_t scroll_curve_show(struct device *dev, struct device_attribute *attr, char *buf) {
+	struct asus_mouse_data *drv_data = dev_get_drvdata(dev);
+	struct asus_mouse_device *device = drv_data->device;
+	struct asus_mouse_curve curve;
+	unsigned long flags;
+
+	spin_lock_irqsave(&device->lock, flags);
+	curve = device->scroll_curve;
+	spin_unlock_irqrestore(&device->lock, flags);
+
+	return asus_mouse_show_curve(buf, &curve);
+}
+
+static ssize_t scroll_curve_store(
+		struct device *dev, struct device_attribute *attr, const char *buf, size_t count) {
+	struct asus_mouse_data *drv_data = dev_get_drvdata(dev);
+	struct asus_mouse_device *device = drv_data->device;
+	struct asus_mouse_curve curve;
+	unsigned long flags;
+	char *str;
+	int ret;
+
+	str = kstrndup(buf, count, GFP_KERNEL);
+	if (!str)
+		return -ENOMEM;
+	ret = asus_mouse_parse_curve(str, &curve);
+	kfree(str);
+	if (ret)
+		return ret;
+
+	spin_lock_irqsave(&device->lock, flags);
+	device->scroll_curve = curve;
+	asus_mouse_curve_build(&device->scroll_curve, device->scroll_period_us, &device->scroll_lut);
+	spin_unlock_irqrestore(&device->lock, flags);
+
+	return count;
+}
+static DEVICE_ATTR_RW(scroll_curve);
+
+/* scroll speed in hi-res units per 16 ms over the joystick offset 0...127 */
+static ssize_t joystick_curve_show(struct device *dev, struct device_attribute *attr, char *buf) {
+	struct asus_mouse_data *drv_data = dev_get_drvdata(dev);
+	struct asus_mouse_device *device = drv_data->device;
+	struct asus_mouse_curve curve;
+	unsigned long flags;
+
+	spin_lock_irqsave(&device->lock, flags);
+	curve = device->joystick.curve;
+	spin_unlock_irqrestore(&device->lock, flags);
+
+	return asus_mouse_show_curve(buf, &curve);
+}
+
+static ssize_t joystick_curve_store(
+		struct device *dev, struct device_attribute *attr, const char *buf, size_t count) {
+	struct asus_mouse_data *drv_data = dev_get_drvdata(dev);
+	struct asus_mouse_device *device = drv_data->device;
+	struct asus_mouse_curve curve;
+	unsigned long flags;
+	char *str;
+	int ret;
+
+	str = kstrndup(buf, count, GFP_KERNEL);
+	if (!str)
+		return -ENOMEM;
+	ret = asus_mouse_parse_curve(str, &curve);
+	kfree(str);
+	if (ret)
+		return ret;
+
+	spin_lock_irqsave(&device->lock, flags);
+	device->joystick.curve = curve;
+	asus_mouse_joystick_build(&device->joystick, device->scroll_period_us);
+	spin_unlock_irqrestore(&device->lock, flags);
+
+	return count;
+}
+static DEVICE_ATTR_RW(joystick_curve);
+
+static ssize_t joystick_deadzone_show(struct device *dev, struct device_attribute *attr, char *buf) {
+	struct asus_mouse_data *drv_data = dev_get_drvdata(dev);
+
+	return sysfs_emit(buf, "%u\n", drv_data->device->joystick.deadzone);
+}
+
+static ssize_t joystick_deadzone_store(
+		struct device *dev, struct device_attribute *attr, const char *buf, size_t count) {
+	struct asus_mouse_data *drv_data = dev_get_drvdata(dev);
+	struct asus_mouse_device *device = drv_data->device;
+	unsigned long flags;
+	unsigned int value;
+	int ret;
+
+	ret = kstrtouint(buf, 0, &value);
+	if (ret)
+		return ret;
+	if (value > ASUS_MOUSE_JOYSTICK_OFFSET_MAX)
+		return -EINVAL;
+
+	spin_lock_irqsave(&device->lock, flags);
+	device->joystick.deadzone = value;
+	spin_unlock_irqrestore(&device->lock, flags);
+
+	return count;
+}
+static DEVICE_ATTR_RW(joystick_deadzone);
+
+static ssize_t joystick_filter_show(struct device *dev, struct device_attribute *attr, char *buf) {
+	struct asus_mouse_data *drv_data = dev_get_drvdata(dev);
+
+	return sysfs_emit(buf, "%u\n", drv_data->device->joystick.filter);
+}
+
+static ssize_t joystick_filter_store(
+		struct device *dev, struct device_attribute *attr, const char *buf, size_t count) {
+	struct asus_mouse_data *drv_data = dev_get_drvdata(dev);
+	struct asus_mouse_device *device = drv_data->device;
+	unsigned long flags;
+	unsigned int value;
+	int ret;
+
+	ret = kstrtouint(buf, 0, &value);
+	if (ret)
+		return ret;
+	if (value > ASUS_MOUSE_JOYSTICK_FILTER_MAX)
+		return -EINVAL;
+
+	spin_lock_irqsave(&device->lock, flags);
+	device->joystick.filter = value;
+	spin_unlock_irqrestore(&device->lock, flags);
+
+	return count;
+}
+static DEVICE_ATTR_RW(joystick_filter);
+
+static ssize_t kinetic_scroll_show(struct device *dev, struct device_attribute *attr, char *buf) {
+	struct asus_mouse_data *drv_data = dev_get_drvdata(dev);
+
+	return sysfs_emit(buf, "%d\n", drv_data->device->kinetic_scroll);
+}
+
+static ssize_t kinetic_scroll_store(
+		struct device *dev, struct device_attribute *attr, const char *buf, size_t count) {
+	struct asus_mouse_data *drv_data = dev_get_drvdata(dev);
+	struct asus_mouse_device *device = drv_data->device;
+	unsigned long flags;
+	bool value;
+	int ret;
+
+	ret = kstrtobool(buf, &value);
+	if (ret)
+		return ret;
+
+	spin_lock_irqsave(&device->lock, flags);
+	device->kinetic_scroll = value;
+	spin_unlock_irqrestore(&device->lock, flags);
+
+	return count;
+}
+static DEVICE_ATTR_RW(kinetic_scroll);
+
+static ssize_t kinetic_friction_show(struct device *dev, struct device_attribute *attr, char *buf) {
+	struct asus_mouse_data *drv_data = dev_get_drvdata(dev);
+
+	return sysfs_emit(buf, "%u\n", drv_data->device->kinetic.friction);
+}
+
+static ssize_t kinetic_friction_store(
+		struct device *dev, struct device_attribute *attr, const char *buf, size_t count) {
+	struct asus_mouse_data *drv_data = dev_get_drvdata(dev);
+	struct asus_mouse_device *device = drv_data->device;
+	unsigned long flags;
+	unsigned int value;
+	int ret;
+
+	ret = kstrtouint(buf, 0, &value);
+	if (ret)
+		return ret;
+	if (!value || value > ASUS_MOUSE_KINETIC_FRICTION_MAX)
+		return -EINVAL;
+
+	spin_lock_irqsave(&device->lock, flags);
+	device->kinetic.friction = value;
+	asus_mouse_kinetic_build(&device->kinetic, device->scroll_period_us);
+	spin_unlock_irqrestore(&device->lock, flags);
+
+	return count;
+}
+static DEVICE_ATTR_RW(kinetic_friction);
+
+static ssize_t kinetic_gain_show(struct device *dev, struct device_attribute *attr, char *buf) {
+	struct asus_mouse_data *drv_data = dev_get_drvdata(dev);
+
+	return sysfs_emit(buf, "%u\n", drv_data->device->kinetic.gain);
+}
+
+static ssize_t kinetic_gain_store(
+		struct device *dev, struct device_attribute *attr, const char *buf, size_t count) {
+	struct asus_mouse_data *drv_data = dev_get_drvdata(dev);
+	struct asus_mouse_device *device = drv_data->device;
+	unsigned long flags;
+	unsigned int value;
+	int ret;
+
+	ret = kstrtouint(buf, 0, &value);
+	if (ret)
+		return ret;
+	if (!value || value > ASUS_MOUSE_KINETIC_GAIN_MAX)
+		return -EINVAL;
+
+	spin_lock_irqsave(&device->lock, flags);
+	device->kinetic.gain = value;
+	spin_unlock_irqrestore(&device->lock, flags);
+
+	return count;
+}
+static DEVICE_ATTR_RW(kinetic_gain);
+
+static ssize_t coalesce_rate_hz_show(struct device *dev, struct device_attribute *attr, char *buf) {
+	struct asus_mouse_data *drv_data = dev_get_drvdata(dev);
+
+	return sysfs_emit(buf, "%u\n", drv_data->device->coalesce_rate_hz);
+}
+
+static ssize_t coalesce_rate_hz_store(
+		struct device *dev, struct device_attribute *attr, const char *buf, size_t count) {
+	struct asus_mouse_data *drv_data = dev_get_drvdata(dev);
+	struct asus_mouse_device *device = drv_data->device;
+	unsigned long flags;
+	unsigned int hz;
+	int ret;
+
+	ret = kstrtouint(buf, 0, &hz);
+	if (ret)
+		return ret;
+	if (hz && (hz < ASUS_MOUSE_COALESCE_RATE_HZ_MIN || hz > ASUS_MOUSE_COALESCE_RATE_HZ_MAX))
+		return -EINVAL;
+
+	spin_lock_irqsave(&device->lock, flags);
+	asus_mouse_set_coalesce_rate(device, hz);
+	spin_unlock_irqrestore(&device->lock, flags);
+
+	return count;
+}
+static DEVICE_ATTR_RW(coalesce_rate_hz);
+
+static ssize_t pointer_scale_show(struct device *dev, struct device_attribute *attr, char *buf) {
+	struct asus_mouse_data *drv_data = dev_get_drvdata(dev);
+
+	return sysfs_emit(buf, "%u\n", drv_data->device->pointer.scale);
+}
+
+static ssize_t pointer_scale_store(
+		struct device *dev, struct device_attribute *attr, const char *buf, size_t count) {
+	struct asus_mouse_data *drv_data = dev_get_drvdata(dev);
+	struct asus_mouse_device *device = drv_data->device;
+	unsigned long flags;
+	unsigned int scale;
+	int ret;
+
+	ret = kstrtouint(buf, 0, &scale);
+	if (ret)
+		return ret;
+	if (!scale || scale > ASUS_MOUSE_POINTER_SCALE_MAX)
+		return -EINVAL;
+
+	spin_lock_irqsave(&device->lock, flags);
+	device->pointer.scale = scale;
+	asus_mouse_pointer_build(&device->pointer);
+	spin_unlock_irqrestore(&device->lock, flags);
 
-static void input_repeat_key(struct timer_list *t) {
-	int ms;
-	u64 dt;
-	unsigned int wheel_factor;
-	short wheel_res = 0;
+	return count;
+}
+static DEVICE_ATTR_RW(pointer_scale);
+
+/* pointer gain in percent over the motion speed 0...127 in counts per report */
+static ssize_t pointer_curve_show(struct device *dev, struct device_attribute *attr, char *buf) {
+	struct asus_mouse_data *drv_data = dev_get_drvdata(dev);
+	struct asus_mouse_device *device = drv_data->device;
+	struct asus_mouse_curve curve;
+	unsigned long flags;
+
+	spin_lock_irqsave(&device->lock, flags);
+	curve = device->pointer.curve;
+	spin_unlock_irqrestore(&device->lock, flags);
+
+	return asus_mouse_show_curve(buf, &curve);
+}
+
+static ssize_t pointer_curve_store(
+		struct device *dev, struct device_attribute *attr, const char *buf, size_t count) {
+	struct asus_mouse_data *drv_data = dev_get_drvdata(dev);
+	struct asus_mouse_device *device = drv_data->device;
+	struct asus_mouse_curve curve;
+	unsigned long flags;
+	char *str;
+	int ret;
+
+	str = kstrndup(buf, count, GFP_KERNEL);
+	if (!str)
+		return -ENOMEM;
+	ret = asus_mouse_parse_curve(str, &curve);
+	kfree(str);
+	if (ret)
+		return ret;
 
-	if (asus_mouse_input->repeat_key) {
-		dt = ktime_get_ns() - asus_mouse_state.ktime_start;
-		dt = (dt > ASUS_MOUSE_KP_WHEEL_TIME_NS) ? ASUS_MOUSE_KP_WHEEL_TIME_NS : dt;
-		wheel_factor = dt * 65536 / ASUS_MOUSE_KP_WHEEL_TIME_NS;  /* 2 ** 16 */
-		wheel_res = ((ASUS_MOUSE_KP_WHEEL_RES_MIN * (65536 - wheel_factor)) +
-					 (ASUS_MOUSE_KP_WHEEL_RES_MAX * wheel_factor)) >> 16;
+	spin_lock_irqsave(&device->lock, flags);
+	device->pointer.curve = curve;
+	asus_mouse_pointer_build(&device->pointer);
+	spin_unlock_irqrestore(&device->lock, flags);
+
+	return count;
+}
+static DEVICE_ATTR_RW(pointer_curve);
+
+static bool asus_mouse_macro_valid(struct input_dev *input, const struct asus_mouse_macro *macro) {
+	const struct asus_mouse_macro_step *step;
+	unsigned int i;
+
+	if (!macro->trigger || macro->trigger > KEY_MAX || macro->steps > ASUS_MOUSE_MACRO_STEPS_MAX)
+		return false;
+
+	for (i = 0; i < macro->steps; i++) {
+		step = &macro->step[i];
+		if (step->delay_us > ASUS_MOUSE_MACRO_DELAY_US_MAX)
+			return false;
+
+		/* only what the input device can send, the input core would drop anything else */
+		switch(step->type) {
+		case EV_KEY:
+			if (step->code > KEY_MAX || !test_bit(step->code, input->keybit) ||
+					step->value < 0 || step->value > 1)
+				return false;
+			break;
+		case EV_REL:
+			if (step->code > REL_MAX || !test_bit(step->code, input->relbit))
+				return false;
+			break;
+		default:
+			return false;
+		}
 	}
 
-	switch(asus_mouse_input->repeat_key) {
-	case KEY_KP4:
-		input_report_rel(asus_mouse_input, REL_HWHEEL_HI_RES, wheel_res);
-		break;
-	case KEY_KP6:
-		input_report_rel(asus_mouse_input, REL_HWHEEL_HI_RES, -wheel_res);
-		break;
-	case KEY_KP2:
-		input_report_rel(asus_mouse_input, REL_WHEEL_HI_RES, -wheel_res);
-		break;
-	case KEY_KP8:
-		input_report_rel(asus_mouse_input, REL_WHEEL_HI_RES, wheel_res);
-		break;
-	default:
-		break;
+	return true;
+}
+
+/* bin_attribute callbacks get a const attribute from 6.13 */
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 13, 0)
+#define asus_mouse_bin_attribute const struct bin_attribute
+#else
+#define asus_mouse_bin_attribute struct bin_attribute
+#endif
+
+/* the macros back to back, each one cut after its last step like when it was written */
+static ssize_t macro_read(struct file *file, struct kobject *kobj,
+		asus_mouse_bin_attribute *attr, char *buf, loff_t off, size_t count) {
+	struct asus_mouse_data *drv_data = dev_get_drvdata(kobj_to_dev(kobj));
+	struct asus_mouse_device *device = drv_data->device;
+	unsigned long flags;
+	size_t len = 0, size;
+	ssize_t ret;
+	u8 *macros;
+	int i;
+
+	macros = kmalloc(attr->size, GFP_KERNEL);
+	if (!macros)
+		return -ENOMEM;
+
+	spin_lock_irqsave(&device->lock, flags);
+	for (i = 0; i < ASUS_MOUSE_MACROS_MAX; i++) {
+		if (!device->macros[i].trigger)
+			continue;
+		size = offsetof(struct asus_mouse_macro, step) +
+			device->macros[i].steps * sizeof(device->macros[i].step[0]);
+		memcpy(macros + len, &device->macros[i], size);
+		len += size;
+	}
+	spin_unlock_irqrestore(&device->lock, flags);
+
+	ret = memory_read_from_buffer(buf, count, &off, macros, len);
+	kfree(macros);
+	return ret;
+}
+
+/* takes one binary "struct asus_mouse_macro" cut after its last step per write */
+static ssize_t macro_write(struct file *file, struct kobject *kobj,
+		asus_mouse_bin_attribute *attr, char *buf, loff_t off, size_t count) {
+	struct asus_mouse_data *drv_data = dev_get_drvdata(kobj_to_dev(kobj));
+	struct asus_mouse_device *device = drv_data->device;
+	struct asus_mouse_macro macro = { };
+	unsigned long flags;
+	int i, slot = -1;
+
+	if (off || count < offsetof(struct asus_mouse_macro, step) || count > sizeof(macro))
+		return -EINVAL;
+	memcpy(&macro, buf, count);
+	if (count != offsetof(struct asus_mouse_macro, step) + macro.steps * sizeof(macro.step[0]) ||
+			!asus_mouse_macro_valid(drv_data->input, &macro))
+		return -EINVAL;
+
+	spin_lock_irqsave(&device->lock, flags);
+
+	for (i = 0; i < ASUS_MOUSE_MACROS_MAX; i++) {
+		if (device->macros[i].trigger == macro.trigger) {
+			slot = i;
+			break;
+		}
+		if (slot < 0 && !device->macros[i].trigger)
+			slot = i;
+	}
+
+	if (slot < 0) {
+		spin_unlock_irqrestore(&device->lock, flags);
+		return -ENOSPC;
 	}
 
-	if (asus_mouse_state.joystick_x)
-		input_report_rel(asus_mouse_input, REL_HWHEEL_HI_RES, asus_mouse_state.joystick_x / 4);
+	/* a callback the cancel loses to finds no macro */
+	if (device->macro == &device->macros[slot]) {
+		hrtimer_try_to_cancel(&device->macro_timer);
+		if (asus_mouse_stop_macro(device))
+			input_sync(device->input);
+	}
+
+	if (!device->macros[slot].trigger && macro.steps)
+		device->macros_num++;
+	else if (device->macros[slot].trigger && !macro.steps)
+		device->macros_num--;
 
-	if (asus_mouse_state.joystick_y)
-		input_report_rel(asus_mouse_input, REL_WHEEL_HI_RES, asus_mouse_state.joystick_y / -4);
+	clear_bit(slot, &device->macros_held);
+	if (macro.steps)
+		device->macros[slot] = macro;
+	else
+		memset(&device->macros[slot], 0, sizeof(device->macros[slot]));
 
-	input_sync(asus_mouse_input);
+	spin_unlock_irqrestore(&device->lock, flags);
 
-	ms = asus_mouse_input->rep[REP_PERIOD];
-	if (ms && (asus_mouse_input->repeat_key ||
-			   asus_mouse_state.joystick_x ||
-			   asus_mouse_state.joystick_y))
-		mod_timer(&asus_mouse_input->timer, jiffies + msecs_to_jiffies(ms));
+	return count;
 }
+static BIN_ATTR_RW(macro, ASUS_MOUSE_MACROS_MAX * sizeof(struct asus_mouse_macro));
 
-static void asus_mouse_handle_mouse(
-		struct asus_mouse_data *drv_data, struct hid_report *report, u8 *data, int size) {
-#ifdef ASUS_MOUSE_DEBUG
-	if (size == 6) {
-		printk(KERN_INFO "hid-asus-mouse: MOUSE %02X %02X %02X %02X %02X %02X",
-			   data[0], data[1], data[2], data[3], data[4], data[5]);
-	} else if (size == 7) {
-		printk(KERN_INFO "hid-asus-mouse: MOUSE %02X %02X %02X %02X %02X %02X %02X",
-			   data[0], data[1], data[2], data[3], data[4], data[5], data[6]);
-	} else if (size == 11) {
-		printk(KERN_INFO "hid-asus-mouse: MOUSE %02X %02X %02X %02X %02X %02X %02X %02X",
-			   data[0], data[1], data[2], data[3], data[4], data[5], data[6], data[7]);
-		printk(KERN_INFO "					  %02X %02X %02X",
-			   data[8], data[9], data[10]);
-	} else {
-		printk(KERN_INFO "hid-asus-mouse: MOUSE X %d", size);
+/*
+ * Mouse settings are only read while a vendor interface is bound, the values
+ * written meanwhile aren't applied yet and aren't shown as if they were.
+ */
+static ssize_t polling_rate_show(struct device *dev, struct device_attribute *attr, char *buf) {
+	struct asus_mouse_data *drv_data = dev_get_drvdata(dev);
+
+	if (!READ_ONCE(drv_data->device->vendor))
+		return -ENODEV;
+	return sysfs_emit(buf, "%u\n", READ_ONCE(drv_data->device->polling_rate));
+}
+
+/* takes a rate in Hz the mouse supports */
+static ssize_t polling_rate_store(
+		struct device *dev, struct device_attribute *attr, const char *buf, size_t count) {
+	struct asus_mouse_data *drv_data = dev_get_drvdata(dev);
+	unsigned int hz, i;
+	int ret;
+
+	ret = kstrtouint(buf, 0, &hz);
+	if (ret)
+		return ret;
+
+	for (i = 0; i < ASUS_MOUSE_RATES; i++)
+		if ((drv_data->profile->rates & (1 << i)) && hz == 125u << i)
+			break;
+	if (i == ASUS_MOUSE_RATES)
+		return -EINVAL;
+
+	WRITE_ONCE(drv_data->device->polling_rate, hz);
+	asus_mouse_vendor_queue(drv_data->device, ASUS_MOUSE_FIELD_RATE(drv_data->profile->dpi_stages), i);
+	return count;
+}
+static DEVICE_ATTR_RW(polling_rate);
+
+/* one value per DPI stage, 0 while unknown */
+static ssize_t dpi_show(struct device *dev, struct device_attribute *attr, char *buf) {
+	struct asus_mouse_data *drv_data = dev_get_drvdata(dev);
+	unsigned int i;
+	int len = 0;
+
+	if (!READ_ONCE(drv_data->device->vendor))
+		return -ENODEV;
+	for (i = 0; i < drv_data->profile->dpi_stages; i++)
+		len += sysfs_emit_at(buf, len, "%s%u", i ? " " : "", READ_ONCE(drv_data->device->dpi[i]));
+
+	return len + sysfs_emit_at(buf, len, "\n");
+}
+
+/* takes the DPI of the first stages, the others are left as they are */
+static ssize_t dpi_store(
+		struct device *dev, struct device_attribute *attr, const char *buf, size_t count) {
+	struct asus_mouse_data *drv_data = dev_get_drvdata(dev);
+	const struct asus_mouse_profile *profile = drv_data->profile;
+	unsigned int dpi[ASUS_MOUSE_DPI_STAGES_MAX];
+	unsigned int i, n = 0;
+	int len;
+
+	while (n < profile->dpi_stages && sscanf(buf, " %u%n", &dpi[n], &len) == 1) {
+		if (dpi[n] < profile->dpi_min || dpi[n] > profile->dpi_max || dpi[n] % profile->dpi_step)
+			return -EINVAL;
+		buf += len;
+		n++;
 	}
-#endif
+	if (!n || !sysfs_streq(buf, ""))
+		return -EINVAL;
 
-	s8 btn = 0;
-	s8 whl = 0;
-	s16 x = 0;
-	s16 y = 0;
-
-	switch(size) {
-	case 6:
-		x = data[1] | (u16)data[2] << 8;
-		y = data[3] | (u16)data[4] << 8;
-		btn = data[0];
-		whl = data[5];
-		break;
+	for (i = 0; i < n; i++) {
+		WRITE_ONCE(drv_data->device->dpi[i], dpi[i]);
+		asus_mouse_vendor_queue(drv_data->device, i, dpi[i] / ASUS_MOUSE_DPI_UNIT - 1);
+	}
+	return count;
+}
+static DEVICE_ATTR_RW(dpi);
 
-	case 7:
-		x = data[1] | (u16)data[2] << 8;
-		y = data[3] | (u16)data[4] << 8;
-		btn = data[5];
-		whl = data[6];
-		break;
+static ssize_t liftoff_show(struct device *dev, struct device_attribute *attr, char *buf) {
+	struct asus_mouse_data *drv_data = dev_get_drvdata(dev);
 
-	case 11:
-		x = data[0] | (u16)data[1] << 8;
-		y = data[2] | (u16)data[3] << 8;
-		btn = data[4];
-		whl = data[5];
-		break;
+	if (!READ_ONCE(drv_data->device->vendor))
+		return -ENODEV;
+	return sysfs_emit(buf, "%d\n", READ_ONCE(drv_data->device->liftoff));
+}
 
-	default:
-		break;
+/* takes a level, 0 for the lowest distance */
+static ssize_t liftoff_store(
+		struct device *dev, struct device_attribute *attr, const char *buf, size_t count) {
+	struct asus_mouse_data *drv_data = dev_get_drvdata(dev);
+	unsigned int level;
+	int ret;
+
+	ret = kstrtouint(buf, 0, &level);
+	if (ret)
+		return ret;
+	if (level >= drv_data->profile->liftoff_levels)
+		return -EINVAL;
+
+	WRITE_ONCE(drv_data->device->liftoff, level);
+	asus_mouse_vendor_queue(drv_data->device,
+		ASUS_MOUSE_FIELD_LIFTOFF(drv_data->profile->dpi_stages), level);
+	return count;
+}
+static DEVICE_ATTR_RW(liftoff);
+
+/* "single", or "active" or "standby" for a mouse bound by RF and USB at once */
+static ssize_t path_show(struct device *dev, struct device_attribute *attr, char *buf) {
+	struct asus_mouse_data *drv_data = dev_get_drvdata(dev);
+	struct asus_mouse_device *device = drv_data->device;
+	struct asus_mouse_device *peer, *link;
+	const char *path = "single";
+
+	rcu_read_lock();
+	peer = rcu_dereference(device->peer);
+	if (peer) {
+		link = device->link_usb ? device : peer;
+		path = READ_ONCE(link->link_active) == device ? "active" : "standby";
+	}
+	rcu_read_unlock();
+
+	return sysfs_emit(buf, "%s\n", path);
+}
+static DEVICE_ATTR_RO(path);
+
+static unsigned long asus_mouse_stats_sum(struct asus_mouse_stats __percpu *stats, size_t offset) {
+	unsigned long sum = 0;
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		sum += *(unsigned long *)((char *)per_cpu_ptr(stats, cpu) + offset);
+
+	return sum;
+}
+
+#define ASUS_MOUSE_STATS_ATTR(_name, _stats) \
+static ssize_t _name##_show(struct device *dev, struct device_attribute *attr, char *buf) { \
+	struct asus_mouse_data *drv_data = dev_get_drvdata(dev); \
+\
+	return sysfs_emit(buf, "%lu\n", \
+		asus_mouse_stats_sum(_stats, offsetof(struct asus_mouse_stats, _name))); \
+} \
+static DEVICE_ATTR_RO(_name)
+
+ASUS_MOUSE_STATS_ATTR(reports_mouse, drv_data->stats);
+ASUS_MOUSE_STATS_ATTR(reports_keyboard, drv_data->stats);
+ASUS_MOUSE_STATS_ATTR(reports_gamepad, drv_data->stats);
+ASUS_MOUSE_STATS_ATTR(reports_other, drv_data->stats);
+ASUS_MOUSE_STATS_ATTR(dropped, drv_data->stats);
+ASUS_MOUSE_STATS_ATTR(key_presses, drv_data->stats);
+ASUS_MOUSE_STATS_ATTR(scroll_timer, drv_data->device->stats);
+ASUS_MOUSE_STATS_ATTR(coalesce_merged, drv_data->device->stats);
+ASUS_MOUSE_STATS_ATTR(coalesce_frames, drv_data->device->stats);
+ASUS_MOUSE_STATS_ATTR(vendor_commands, drv_data->device->stats);
+ASUS_MOUSE_STATS_ATTR(vendor_merged, drv_data->device->stats);
+ASUS_MOUSE_STATS_ATTR(vendor_retries, drv_data->device->stats);
+ASUS_MOUSE_STATS_ATTR(vendor_timeouts, drv_data->device->stats);
+ASUS_MOUSE_STATS_ATTR(vendor_failed, drv_data->device->stats);
+ASUS_MOUSE_STATS_ATTR(suppressed, drv_data->stats);
+ASUS_MOUSE_STATS_ATTR(path_switches, drv_data->device->stats);
+
+/* "<length> <reports>" for every report length seen, the last one is "64+" */
+static ssize_t reports_size_show(struct device *dev, struct device_attribute *attr, char *buf) {
+	struct asus_mouse_data *drv_data = dev_get_drvdata(dev);
+	unsigned long count;
+	int i, len = 0;
+
+	for (i = 0; i < ASUS_MOUSE_STATS_SIZES; i++) {
+		count = asus_mouse_stats_sum(drv_data->stats,
+			offsetof(struct asus_mouse_stats, reports_size) + i * sizeof(count));
+		if (count)
+			len += sysfs_emit_at(buf, len, "%d%s %lu\n",
+				i, i == ASUS_MOUSE_STATS_SIZES - 1 ? "+" : "", count);
+	}
+
+	return len;
+}
+static DEVICE_ATTR_RO(reports_size);
+
+static struct attribute *asus_mouse_stats_attrs[] = {
+	&dev_attr_reports_mouse.attr,
+	&dev_attr_reports_keyboard.attr,
+	&dev_attr_reports_gamepad.attr,
+	&dev_attr_reports_other.attr,
+	&dev_attr_reports_size.attr,
+	&dev_attr_dropped.attr,
+	&dev_attr_key_presses.attr,
+	&dev_attr_scroll_timer.attr,
+	&dev_attr_coalesce_merged.attr,
+	&dev_attr_coalesce_frames.attr,
+	&dev_attr_vendor_commands.attr,
+	&dev_attr_vendor_merged.attr,
+	&dev_attr_vendor_retries.attr,
+	&dev_attr_vendor_timeouts.attr,
+	&dev_attr_vendor_failed.attr,
+	&dev_attr_suppressed.attr,
+	&dev_attr_path_switches.attr,
+	NULL,
+};
+
+static const struct attribute_group asus_mouse_stats_group = {
+	.name = "stats",
+	.attrs = asus_mouse_stats_attrs,
+};
+
+static struct attribute *asus_mouse_attrs[] = {
+	&dev_attr_scroll_period_us.attr,
+	&dev_attr_scroll_curve.attr,
+	&dev_attr_joystick_curve.attr,
+	&dev_attr_joystick_deadzone.attr,
+	&dev_attr_joystick_filter.attr,
+	&dev_attr_kinetic_scroll.attr,
+	&dev_attr_kinetic_friction.attr,
+	&dev_attr_kinetic_gain.attr,
+	&dev_attr_coalesce_rate_hz.attr,
+	&dev_attr_pointer_scale.attr,
+	&dev_attr_pointer_curve.attr,
+	&dev_attr_polling_rate.attr,
+	&dev_attr_dpi.attr,
+	&dev_attr_liftoff.attr,
+	&dev_attr_path.attr,
+	NULL,
+};
+
+/* settings the mouse doesn't have aren't shown */
+static umode_t asus_mouse_attr_visible(struct kobject *kobj, struct attribute *attr, int n) {
+	struct asus_mouse_data *drv_data = dev_get_drvdata(kobj_to_dev(kobj));
+	const struct asus_mouse_profile *profile = drv_data->profile;
+
+	if (attr == &dev_attr_polling_rate.attr && !profile->rates)
+		return 0;
+	if (attr == &dev_attr_dpi.attr && !profile->dpi_stages)
+		return 0;
+	if (attr == &dev_attr_liftoff.attr && !profile->liftoff_levels)
+		return 0;
+
+	return attr->mode;
+}
+
+static const struct attribute_group asus_mouse_group = {
+	.attrs = asus_mouse_attrs,
+	.is_visible = asus_mouse_attr_visible,
+};
+
+static const struct attribute_group *asus_mouse_groups[] = {
+	&asus_mouse_group,
+	&asus_mouse_stats_group,
+	NULL,
+};
+
+static int asus_mouse_hist_show(struct seq_file *m, void *v) {
+	struct asus_mouse_hist *hist = m->private;
+	unsigned long count;
+	unsigned int i;
+
+	seq_puts(m, "ns count\n");
+	for (i = 0; i < ASUS_MOUSE_HIST_BUCKETS; i++) {
+		count = atomic_long_read(&hist->bucket[i]);
+		if (!count)
+			continue;
+		if (!i)
+			seq_printf(m, "0 %lu\n", count);
+		else if (i == ASUS_MOUSE_HIST_BUCKETS - 1)
+			seq_printf(m, "%llu+ %lu\n", 1ull << (i - 1), count);
+		else
+			seq_printf(m, "%llu-%llu %lu\n", 1ull << (i - 1), (1ull << i) - 1, count);
 	}
 
-#ifdef ASUS_MOUSE_DEBUG
-	printk(KERN_INFO "hid-asus-mouse: X=%d Y=%d BTN=%02X WHL=%d", x, y, btn, whl);
+	return 0;
+}
+
+static int asus_mouse_hist_open(struct inode *inode, struct file *file) {
+	return single_open(file, asus_mouse_hist_show, inode->i_private);
+}
+
+/* any write resets the histogram */
+static ssize_t asus_mouse_hist_write(
+		struct file *file, const char __user *buf, size_t count, loff_t *ppos) {
+	struct asus_mouse_hist *hist = ((struct seq_file *)file->private_data)->private;
+	unsigned int i;
+
+	for (i = 0; i < ASUS_MOUSE_HIST_BUCKETS; i++)
+		atomic_long_set(&hist->bucket[i], 0);
+
+	return count;
+}
+
+static const struct file_operations asus_mouse_hist_fops = {
+	.owner = THIS_MODULE,
+	.open = asus_mouse_hist_open,
+	.read = seq_read,
+	.write = asus_mouse_hist_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+/* read-only mapping of the whole ring, records are read in place */
+static int asus_mouse_capture_mmap(struct file *file, struct vm_area_struct *vma) {
+	if (vma->vm_flags & VM_WRITE)
+		return -EPERM;
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 3, 0)
+	vm_flags_clear(vma, VM_MAYWRITE);
+#else
+	vma->vm_flags &= ~VM_MAYWRITE;
 #endif
 
-	input_report_key(drv_data->input, BTN_LEFT, (btn & (1 << 0)) != 0);
-	input_report_key(drv_data->input, BTN_RIGHT, (btn & (1 << 1)) != 0);
-	input_report_key(drv_data->input, BTN_MIDDLE, (btn & (1 << 2)) != 0);
-	input_report_key(drv_data->input, BTN_FORWARD, (btn & (1 << 3)) != 0);
-	input_report_key(drv_data->input, BTN_BACK, (btn & (1 << 4)) != 0);
-	input_report_rel(drv_data->input, REL_X, x);
-	input_report_rel(drv_data->input, REL_Y, y);
-	input_report_rel(drv_data->input, REL_WHEEL_HI_RES, whl * ASUS_MOUSE_MOUSE_WHEEL_RES);
-	input_sync(drv_data->input);
-}
-
-static void asus_mouse_handle_keyboard(
-		struct asus_mouse_data *drv_data, struct hid_report *report, u8 *data, int size) {
-#ifdef LOGI_MOUSE_DEBUG
-	if (size == 8) {
-		printk(KERN_INFO "hid-asus-mouse: KEYS %02X %02X %02X %02X %02X %02X %02X %02X",
-			   data[0], data[1], data[2], data[3], data[4], data[5], data[6], data[7]);
-	} else if (size == 9) {
-		printk(KERN_INFO "hid-asus-mouse: KEYS %02X %02X %02X %02X %02X %02X %02X %02X %02X",
-			   data[0], data[1], data[2], data[3], data[4], data[5], data[6], data[7], data[8]);
-	} else if (size == 12) {
-		printk(KERN_INFO "hid-asus-mouse: KEYS %02X %02X %02X %02X %02X %02X %02X %02X",
-			   data[0], data[1], data[2], data[3], data[4], data[5], data[6], data[7]);
-		printk(KERN_INFO "					 %02X %02X %02X %02X",
-			   data[8], data[9], data[10], data[11]);
+	return remap_vmalloc_range(vma, asus_mouse_capture.buf, vma->vm_pgoff);
+}
+
+/* a snapshot of the ring, for "cp capture capture.bin" */
+static ssize_t asus_mouse_capture_read(struct file *file, char __user *buf, size_t count, loff_t *ppos) {
+	return simple_read_from_buffer(buf, count, ppos, asus_mouse_capture.buf, asus_mouse_capture.size);
+}
+
+static const struct file_operations asus_mouse_capture_fops = {
+	.owner = THIS_MODULE,
+	.read = asus_mouse_capture_read,
+	.mmap = asus_mouse_capture_mmap,
+	.llseek = default_llseek,
+};
+
+static int asus_mouse_capture_init(void) {
+	struct asus_mouse_capture_header *header;
+	unsigned int records;
+
+	if (!capture_records)
+		return 0;
+
+	records = roundup_pow_of_two(min_t(unsigned int, capture_records, ASUS_MOUSE_CAPTURE_RECORDS_MAX));
+	asus_mouse_capture.size = PAGE_ALIGN(PAGE_SIZE + records * sizeof(struct asus_mouse_capture_record));
+	asus_mouse_capture.buf = vmalloc_user(asus_mouse_capture.size);
+	if (!asus_mouse_capture.buf)
+		return -ENOMEM;
+
+	header = asus_mouse_capture.buf;
+	header->magic = ASUS_MOUSE_CAPTURE_MAGIC;
+	header->version = ASUS_MOUSE_CAPTURE_VERSION;
+	header->record_size = sizeof(struct asus_mouse_capture_record);
+	header->records = records;
+	header->records_offset = PAGE_SIZE;
+
+	asus_mouse_capture.mask = records - 1;
+	asus_mouse_capture.records = asus_mouse_capture.buf + PAGE_SIZE;
+
+	/* mmap isn't proxied by debugfs, an open file pins the module instead */
+	debugfs_create_file_unsafe("capture", 0400, asus_mouse_debugfs_root, NULL, &asus_mouse_capture_fops);
+	return 0;
+}
+
+static void asus_mouse_debugfs_init(struct asus_mouse_device *device) {
+	device->debugfs = debugfs_create_dir(device->name, asus_mouse_debugfs_root);
+	debugfs_create_file("raw_event_ns", 0600, device->debugfs,
+		&device->raw_event_hist, &asus_mouse_hist_fops);
+	debugfs_create_file("report_interval_ns", 0600, device->debugfs,
+		&device->report_interval_hist, &asus_mouse_hist_fops);
+	debugfs_create_file("scroll_lateness_ns", 0600, device->debugfs,
+		&device->scroll_lateness_hist, &asus_mouse_hist_fops);
+}
+
+/*
+ * Interfaces of a USB mouse share the USB device. On other buses, e.g. a
+ * Bluetooth mouse or the uhid simulator, they share their "phys" up to the
+ * interface number and their "uniq", anything without them stands on its own.
+ * Returns the USB device, NULL on other buses, and names the mouse.
+ */
+static struct device *asus_mouse_physical_device(struct hid_device *hdev, char *name, size_t size) {
+	const char *input;
+	int len;
+
+	if (hid_is_usb(hdev)) {
+		strscpy(name, dev_name(hdev->dev.parent->parent), size);
+		return hdev->dev.parent->parent;
+	}
+
+	if (hdev->phys[0]) {
+		input = strstr(hdev->phys, "/input");
+		len = input ? input - hdev->phys : strlen(hdev->phys);
+		snprintf(name, size, "%.*s%s%s", len, hdev->phys, hdev->uniq[0] ? "-" : "", hdev->uniq);
 	} else {
-		printk(KERN_INFO "hid-logi-mouse: KEYS X %d", size);
+		strscpy(name, dev_name(&hdev->dev), size);
 	}
-#endif
+	/* it names a debugfs directory too */
+	strreplace(name, '/', '_');
+	return NULL;
+}
 
-	int i, bit, code, asus_code, key_code, offset;
-	u32 bitmask[ASUS_MOUSE_DATA_KEY_STATE_NUM];
-	u32 modified;
-	for (i = 0; i < ASUS_MOUSE_DATA_KEY_STATE_NUM; i++)
-		bitmask[i] = 0;
-
-	/* build bitmask */
-
-	switch(size) {
-	case ASUS_MOUSE_KEYS_BITMASK_EVENT_SIZE:
-		/* build bitmask from event data */
-		offset = size - 1;
-		for (i = 0; i < ASUS_MOUSE_DATA_KEY_STATE_NUM; i++) {
-			bit = 0;
-			if (i == 0)  /* first byte of 16-byte number is missing, so we skip it */
-				bit = 8;
-			for (; bit < ASUS_MOUSE_DATA_KEY_STATE_BITS; bit += 8) {
-				bitmask[i] |= data[offset] << (ASUS_MOUSE_DATA_KEY_STATE_BITS - 8 - bit);
-				offset--;
-			}
-		}
-		break;
+/*
+ * Keys advertised from the start, KEY_ESC...KEY_MEDIA and more, so modifiers
+ * and keys of macros or remapped later are accepted whatever the keymap holds.
+ */
+static const u64 asus_mouse_base_keys[] = {
+	0xfffffffffffffffe, 0xfebeffdff3cfffff, 0xff800078000007ff, 0x1000300000007,
+};
 
-	default:
-		/* build bitmask from array of active key codes */
-		offset = 3;
-		if (size == 8)
-			offset--;
-
-		for (; offset < size; offset++) {
-			code = data[offset];
-			if (!code)
-				continue;
-			i = ASUS_MOUSE_DATA_KEY_STATE_NUM - (code / ASUS_MOUSE_DATA_KEY_STATE_BITS) - 1;
-			bitmask[i] |= 1 << (code % ASUS_MOUSE_DATA_KEY_STATE_BITS);
-		}
-		break;
+static bool asus_mouse_base_key(unsigned int code) {
+	return code < ARRAY_SIZE(asus_mouse_base_keys) * 64 &&
+		(asus_mouse_base_keys[code / 64] & (1ull << (code % 64)));
+}
+
+/*
+ * The input core's default handler, except that a key mapped away from its
+ * last scancode stays advertised if it's a base key. Called with the input
+ * device's "event_lock" held.
+ */
+static int asus_mouse_setkeycode(
+		struct input_dev *input, const struct input_keymap_entry *ke, unsigned int *old_keycode) {
+	unsigned short *keymap = input->keycode;
+	unsigned int index, i;
+	int ret;
+
+	if (ke->flags & INPUT_KEYMAP_BY_INDEX) {
+		index = ke->index;
+	} else {
+		ret = input_scancode_to_scalar(ke, &index);
+		if (ret)
+			return ret;
 	}
+	if (index >= input->keycodemax)
+		return -EINVAL;
 
-#ifdef ASUS_MOUSE_DEBUG
-	printk(KERN_INFO "hid-asus-mouse: STAT %08X %08X %08X %08X",
-		   drv_data->key_state[0], drv_data->key_state[1], drv_data->key_state[2], drv_data->key_state[3]);
-	printk(KERN_INFO "hid-asus-mouse: MASK %08X %08X %08X %08X",
-		   bitmask[0], bitmask[1], bitmask[2], bitmask[3]);
-#endif
+	*old_keycode = keymap[index];
+	keymap[index] = ke->keycode;
+	__set_bit(ke->keycode, input->keybit);
 
-	/* get key codes and send key events */
+	if (asus_mouse_base_key(*old_keycode))
+		return 0;
+	for (i = 0; i < input->keycodemax; i++)
+		if (keymap[i] == *old_keycode)
+			return 0;
+	__clear_bit(*old_keycode, input->keybit);
+	return 0;
+}
 
-	for (i = 0; i < ASUS_MOUSE_DATA_KEY_STATE_NUM; i++) {
-		modified = drv_data->key_state[ASUS_MOUSE_DATA_KEY_STATE_NUM - i - 1] ^
-			bitmask[ASUS_MOUSE_DATA_KEY_STATE_NUM - i - 1];
-		for (bit = 0; bit < ASUS_MOUSE_DATA_KEY_STATE_BITS; bit += 1) {
-			if (!(modified & (1 << bit)))
-				continue;
+/*
+ * The keymap is the input device's scancode table, so EVIOCSKEYCODE and udev
+ * hwdb remap keys in place, "keybit" following the keymap on top of the base
+ * keys. Scancodes are ASUS key codes.
+ */
+static struct input_dev *asus_mouse_input_create(
+		const char *phys, struct hid_device *hdev, struct device *parent, unsigned short *keymap) {
+	struct input_dev *input;
+	int ret, i;
+
+	input = input_allocate_device();
+	if (!input)
+		return ERR_PTR(-ENOMEM);
+
+	input->name = "ASUS mouse input";
+	input->phys = phys;
+
+	if (hdev) {
+		input->id.bustype = hdev->bus;
+		input->id.product = hdev->product;
+		input->id.vendor = hdev->vendor;
+		input->id.version = hdev->version;
+		input->dev.parent = parent;
+	} else {
+		input->id.bustype = BUS_VIRTUAL;
+		input->id.product = 0x0000;
+		input->id.vendor = 0x0000;
+		input->id.version = 0x0000;
+	}
 
-			asus_code = i * ASUS_MOUSE_DATA_KEY_STATE_BITS + bit;
-			if (asus_code >= ASUS_MOUSE_MAPPING_SIZE)
-				continue;
+	for (i = 0; i <= KEY_MAX; i++)
+		if (asus_mouse_base_key(i))
+			set_bit(i, input->keybit);
+
+	memcpy(keymap, asus_mouse_key_mapping, ASUS_MOUSE_MAPPING_SIZE * sizeof(*keymap));
+	input->keycode = keymap;
+	input->keycodesize = sizeof(*keymap);
+	input->keycodemax = ASUS_MOUSE_MAPPING_SIZE;
+	input->setkeycode = asus_mouse_setkeycode;
+	for (i = 0; i < ASUS_MOUSE_MAPPING_SIZE; i++)
+		if (keymap[i])
+			set_bit(keymap[i], input->keybit);
+
+	set_bit(EV_REL, input->evbit);
+	set_bit(EV_KEY, input->evbit);
+
+	set_bit(REL_X, input->relbit);
+	set_bit(REL_Y, input->relbit);
+	set_bit(REL_WHEEL, input->relbit);
+	set_bit(REL_WHEEL_HI_RES, input->relbit);
+	set_bit(REL_HWHEEL, input->relbit);
+	set_bit(REL_HWHEEL_HI_RES, input->relbit);
+
+	set_bit(BTN_LEFT, input->keybit);
+	set_bit(BTN_RIGHT, input->keybit);
+	set_bit(BTN_MIDDLE, input->keybit);
+	set_bit(BTN_BACK, input->keybit);
+	set_bit(BTN_FORWARD, input->keybit);
+	set_bit(BTN_TOOL_DOUBLETAP, input->keybit);
+	set_bit(KEY_BACK, input->keybit);
+	set_bit(KEY_FORWARD, input->keybit);
+
+	ret = input_register_device(input);
+	if (ret) {
+		input_free_device(input);
+		return ERR_PTR(ret);
+	}
 
-			key_code = asus_mouse_key_mapping[asus_code];
+	return input;
+}
 
-			if (bitmask[ASUS_MOUSE_DATA_KEY_STATE_NUM - i - 1] & (1 << bit)) { /* key pressed */
-#ifdef ASUS_MOUSE_DEBUG
-				printk(KERN_INFO "hid-asus-mouse: PRES ASUS=0x%02X (%d) LINUX=0x%02X (%d) '%c'",
-					   asus_code, asus_code, key_code, key_code, key_code);
-#endif
-				switch(key_code) {
-				case KEY_KP4:
-				case KEY_KP6:
-				case KEY_KP2:
-				case KEY_KP8:
-					/* start repeating key events */
-					asus_mouse_input->repeat_key = key_code;
-					asus_mouse_state.ktime_start = ktime_get_ns();
-					input_repeat_key(NULL);
-					break;
-				default:
-					/* send regular key press event */
-					input_report_key(drv_data->input, key_code, 1);
-					input_sync(drv_data->input);
-					break;
-				}
-			} else { /* key released */
-#ifdef ASUS_MOUSE_DEBUG
-				printk(KERN_INFO "hid-asus-mouse: RELE ASUS=0x%02X (%d) LINUX=0x%02X (%d) '%c'",
-					   asus_code, asus_code, key_code, key_code, key_code);
-#endif
-				switch(key_code) {
-				case KEY_KP4:
-				case KEY_KP6:
-				case KEY_KP2:
-				case KEY_KP8:
-					/* stop repeating key events */
-					asus_mouse_input->repeat_key = 0;
-					asus_mouse_state.ktime_start = 0;
-					break;
-				default:
-					/* send regular key release event */
-					input_report_key(drv_data->input, key_code, 0);
-					input_sync(drv_data->input);
-					break;
-				}
-			}
+/*
+ * Links a new device to the other path of the same model, as the RF and USB
+ * instances of one model bound at once are taken for one mouse charging over
+ * its cable. Called with "asus_mouse_device_lock" held.
+ */
+static void asus_mouse_device_link(struct asus_mouse_device *device, struct hid_device *hdev) {
+	struct asus_mouse_device *peer;
+	u16 peer_product = 0;
+	bool usb = false;
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_SIZE(asus_mouse_pairs) && !peer_product; i++) {
+		if (device->product == asus_mouse_pairs[i].rf) {
+			peer_product = asus_mouse_pairs[i].usb;
+		} else if (device->product == asus_mouse_pairs[i].usb) {
+			peer_product = asus_mouse_pairs[i].rf;
+			usb = true;
 		}
 	}
+	if (!peer_product)
+		return;
 
-	/* save current keys state for tracking released keys */
+	list_for_each_entry(peer, &asus_mouse_device_list, list) {
+		if (peer->product != peer_product || rcu_access_pointer(peer->peer))
+			continue;
 
-	for (i = 0; i < ASUS_MOUSE_DATA_KEY_STATE_NUM; i++)
-		drv_data->key_state[i] = bitmask[i];
+		device->link_usb = usb;
+		peer->link_usb = !usb;
+		WRITE_ONCE((usb ? device : peer)->link_active, NULL);
+		rcu_assign_pointer(device->peer, peer);
+		rcu_assign_pointer(peer->peer, device);
+		hid_info(hdev, "linked to %s, only one path of the mouse is decoded\n", peer->name);
+		return;
+	}
 }
 
-static void asus_mouse_handle_joystick(
-		struct asus_mouse_data *drv_data, struct hid_report *report, u8 *data, int size) {
-	int x, y;
-	bool activated = false;
+static struct asus_mouse_device *asus_mouse_device_get(struct hid_device *hdev) {
+	struct asus_mouse_device *device;
+	struct input_dev *input;
+	struct device *parent;
+	char name[sizeof(device->name)];
 
-#ifdef ASUS_MOUSE_DEBUG
-	printk(KERN_INFO "hid-asus-mouse: JOYS %02X %02X %02X %02X",
-		   data[0], data[1], data[2], data[3]);
-#endif
+	parent = asus_mouse_physical_device(hdev, name, sizeof(name));
 
-	/* 0...255 -> -127...127 */
-	switch(size) {
-	case 5:
-		x = data[1] - 128;
-		y = data[2] - 128;
-		break;
+	mutex_lock(&asus_mouse_device_lock);
 
-	default:
-		x = data[0] - 128;
-		y = data[1] - 128;
-		break;
+	list_for_each_entry(device, &asus_mouse_device_list, list) {
+		if (!strcmp(device->name, name)) {
+			device->users++;
+			goto out;
+		}
+	}
+
+	device = kzalloc(sizeof(*device), GFP_KERNEL);
+	if (!device) {
+		device = ERR_PTR(-ENOMEM);
+		goto out;
 	}
 
-	if (x > -ASUS_MOUSE_JOYSTICK_DEADZONE && x < ASUS_MOUSE_JOYSTICK_DEADZONE)
-		x = 0;
-	if (y > -ASUS_MOUSE_JOYSTICK_DEADZONE && y < ASUS_MOUSE_JOYSTICK_DEADZONE)
-		y = 0;
+	device->stats = alloc_percpu(struct asus_mouse_stats);
+	if (!device->stats) {
+		kfree(device);
+		device = ERR_PTR(-ENOMEM);
+		goto out;
+	}
 
-	if (!asus_mouse_state.joystick_x && !asus_mouse_state.joystick_y && (x || y))
-		activated = true;
+	strscpy(device->name, name, sizeof(device->name));
+	device->parent = parent;
+	device->users = 1;
+	spin_lock_init(&device->lock);
+	asus_mouse_hrtimer_setup(&device->scroll_timer, asus_mouse_scroll_timer);
+	device->scroll_curve = asus_mouse_default_curve;
+	device->joystick.deadzone = ASUS_MOUSE_JOYSTICK_DEADZONE;
+	device->joystick.filter = ASUS_MOUSE_JOYSTICK_FILTER;
+	device->joystick.curve = asus_mouse_default_joystick_curve;
+	device->kinetic_scroll = READ_ONCE(kinetic_scroll);
+	device->kinetic.friction = clamp_t(unsigned int, READ_ONCE(kinetic_friction),
+		1, ASUS_MOUSE_KINETIC_FRICTION_MAX);
+	device->kinetic.gain = clamp_t(unsigned int, READ_ONCE(kinetic_gain),
+		1, ASUS_MOUSE_KINETIC_GAIN_MAX);
+	asus_mouse_set_scroll_period(device, READ_ONCE(scroll_period_us));
+	device->pointer.scale = ASUS_MOUSE_POINTER_SCALE;
+	device->pointer.curve = asus_mouse_default_pointer_curve;
+	asus_mouse_pointer_build(&device->pointer);
+	asus_mouse_hrtimer_setup(&device->coalesce_timer, asus_mouse_coalesce_timer);
+	asus_mouse_set_coalesce_rate(device, READ_ONCE(coalesce_rate_hz));
+	asus_mouse_hrtimer_setup(&device->macro_timer, asus_mouse_macro_timer);
+	mutex_init(&device->vendor_lock);
+	init_completion(&device->vendor_done);
+	INIT_WORK(&device->vendor_work, asus_mouse_vendor_work);
+	device->liftoff = -1;
+
+	if (per_device_input) {
+		snprintf(device->phys, sizeof(device->phys), "hid-asus-mouse/%s", name);
+		input = asus_mouse_input_create(device->phys, hdev, parent, device->keymap);
+		if (IS_ERR(input)) {
+			free_percpu(device->stats);
+			kfree(device);
+			device = ERR_CAST(input);
+			goto out;
+		}
+		device->input = input;
+		device->own_input = true;
+	} else {
+		device->input = asus_mouse_input;
+	}
 
-	asus_mouse_state.joystick_x = x;
-	asus_mouse_state.joystick_y = y;
+	asus_mouse_debugfs_init(device);
+	if (hdev->vendor == USB_VENDOR_ID_ASUSTEK) {
+		device->product = hdev->product;
+		asus_mouse_device_link(device, hdev);
+	}
+	list_add(&device->list, &asus_mouse_device_list);
 
-	if (activated)
-		input_repeat_key(NULL);
+out:
+	mutex_unlock(&asus_mouse_device_lock);
+	return device;
 }
 
-static int asus_mouse_raw_event(
-		struct hid_device *hdev, struct hid_report *report, u8 *data, int size) {
-	struct usb_interface *iface = NULL;
+static void asus_mouse_device_put(struct asus_mouse_device *device) {
+	struct asus_mouse_device *peer;
 
-	struct asus_mouse_data *drv_data = hid_get_drvdata(hdev);
-	if (!drv_data)
-		return 0;
+	mutex_lock(&asus_mouse_device_lock);
+	if (--device->users) {
+		mutex_unlock(&asus_mouse_device_lock);
+		return;
+	}
+	list_del(&device->list);
+	peer = rcu_dereference_protected(device->peer, lockdep_is_held(&asus_mouse_device_lock));
+	if (peer) {
+		WRITE_ONCE((device->link_usb ? device : peer)->link_active, NULL);
+		RCU_INIT_POINTER(peer->peer, NULL);
+		RCU_INIT_POINTER(device->peer, NULL);
+	}
+	mutex_unlock(&asus_mouse_device_lock);
+
+	/* the peer's raw_event may still look at this device */
+	if (peer)
+		synchronize_rcu();
+
+	debugfs_remove_recursive(device->debugfs);
+
+	device->repeat_key = 0;
+	memset(device->joystick.target, 0, sizeof(device->joystick.target));
+	memset(device->joystick.pos, 0, sizeof(device->joystick.pos));
+	device->kinetic.rest = 0;
+	device->macro = NULL;
+	hrtimer_cancel(&device->macro_timer);
+	hrtimer_cancel(&device->coalesce_timer);
+	hrtimer_cancel(&device->scroll_timer);
+	cancel_work_sync(&device->vendor_work);
+
+	if (device->own_input)
+		input_unregister_device(device->input);
+	free_percpu(device->stats);
+	kfree(device);
+}
 
-	if (hdev->dev.parent != NULL)
-		iface = to_usb_interface(hdev->dev.parent);
+/*
+ * IDs added through "new_id" have no profile, or a "driver_data" that can't be
+ * trusted, they get the generic one.
+ */
+static const struct asus_mouse_profile *asus_mouse_find_profile(const struct hid_device_id *id) {
+	unsigned int i;
 
-#ifdef ASUS_MOUSE_DEBUG
-	printk(KERN_INFO "hid-asus-mouse: RAW FROM=%d SIZE=%d TYPE=%d APP=%d",
-		   (iface != NULL) ? iface->cur_altsetting->desc.bInterfaceProtocol : 0,
-		   size, report->type, report->application);
+	for (i = 0; i < ARRAY_SIZE(asus_mouse_profiles); i++)
+		if (id->driver_data == (kernel_ulong_t)asus_mouse_profiles[i])
+			return asus_mouse_profiles[i];
 
-	for (int i = 0; i < report->maxfield; i++) {
-		printk(KERN_INFO "hid-asus-mouse: FLD %d PHY=%d LOG=%d APP=%d",
-			   i, report->field[i]->physical, report->field[i]->logical,
-			   report->field[i]->application);
-		/* for (int j = 0; j < report->field[i]->maxusage; j++) */
-		/*   hid_resolv_usage(report->field[i]->usage[j].hid); */
-	}
-#endif
+	return &asus_mouse_profile_generic;
+}
 
-	switch(report->application) {
-	case HID_GD_MOUSE:
-		asus_mouse_handle_mouse(drv_data, report, data, size);
-		break;
-	case HID_GD_KEYBOARD:
-		asus_mouse_handle_keyboard(drv_data, report, data, size);
-		break;
-	case HID_GD_GAMEPAD:
-		asus_mouse_handle_joystick(drv_data, report, data, size);
-		break;
-	default:
-		break;
+/* picks the decoder of every input report once, by its application and length */
+static void asus_mouse_resolve_reports(struct hid_device *hdev, struct asus_mouse_data *drv_data) {
+	struct hid_report_enum *report_enum = &hdev->report_enum[HID_INPUT_REPORT];
+	const struct asus_mouse_layout *layout;
+	struct asus_mouse_report *entry;
+	struct hid_report *report;
+	int size;
+
+	list_for_each_entry(report, &report_enum->report_list, list) {
+		if (!asus_mouse_decodes_application(report->application))
+			continue;
+
+		entry = &drv_data->reports[report->id];
+		entry->application = report->application;
+
+		size = hid_report_len(report);
+		layout = asus_mouse_find_layout(report->application, size, drv_data->decoder.caps);
+		if (!layout) {
+			hid_dbg(hdev, "no decoder for report %u of application 0x%x, %d bytes\n",
+					report->id, report->application, size);
+			continue;
+		}
+
+		entry->decode = layout->decode;
+		entry->size = size;
 	}
+}
+
+/*
+ * Ties an interface to the device of its physical mouse and picks the decoders
+ * of its reports. "drv_data" and its stats are allocated by the caller.
+ */
+static int asus_mouse_attach(
+		struct hid_device *hdev, const struct hid_device_id *id, struct asus_mouse_data *drv_data) {
+	drv_data->profile = asus_mouse_find_profile(id);
+	drv_data->decoder.caps = drv_data->profile->caps;
+	asus_mouse_resolve_reports(hdev, drv_data);
+
+	drv_data->device = asus_mouse_device_get(hdev);
+	if (IS_ERR(drv_data->device))
+		return PTR_ERR(drv_data->device);
+	drv_data->input = drv_data->device->input;
+	drv_data->decoder.keymap = drv_data->input->keycode;
+	hid_set_drvdata(hdev, drv_data);
 
 	return 0;
 }
 
 static int asus_mouse_probe(struct hid_device *hdev, const struct hid_device_id *id) {
 	struct asus_mouse_data *drv_data;
+	struct hid_report *report;
 	int ret;
 
 	ret = hid_parse(hdev);
@@ -354,24 +2377,59 @@ static int asus_mouse_probe(struct hid_device *hdev, const struct hid_device_id
 		hid_err(hdev, "%s: failed with error %d\n", __func__, ret);
 		return -ENOMEM;
 	}
-	drv_data->input = asus_mouse_input;
-	for (int i = 0; i < ASUS_MOUSE_DATA_KEY_STATE_NUM; i++)
-		drv_data->key_state[i] = 0;
-	hid_set_drvdata(hdev, drv_data);
 
-	ret = hid_hw_start(hdev, HID_CONNECT_HIDRAW);
+	drv_data->stats = devm_alloc_percpu(&hdev->dev, struct asus_mouse_stats);
+	if (!drv_data->stats)
+		return -ENOMEM;
+
+	ret = asus_mouse_attach(hdev, id, drv_data);
 	if (ret) {
 		hid_err(hdev, "%s: failed with error %d\n", __func__, ret);
 		return ret;
 	}
 
+	ret = hid_hw_start(hdev, HID_CONNECT_HIDRAW);
+	if (ret) {
+		hid_err(hdev, "%s: failed with error %d\n", __func__, ret);
+		goto err_put;
+	}
+
 	ret = hid_hw_open(hdev);
 	if (ret) {
 		hid_err(hdev, "%s: failed with error %d\n", __func__, ret);
-		return ret;
+		goto err_stop;
+	}
+
+	ret = device_create_bin_file(&hdev->dev, &bin_attr_macro);
+	if (ret) {
+		hid_err(hdev, "%s: failed with error %d\n", __func__, ret);
+		goto err_close;
+	}
+
+	/* configuration commands go through the first vendor interface */
+	report = asus_mouse_find_vendor_report(hdev);
+	if (report) {
+		mutex_lock(&drv_data->device->vendor_lock);
+		if (!drv_data->device->vendor) {
+			drv_data->device->vendor_report = report;
+			WRITE_ONCE(drv_data->device->vendor, hdev);
+		}
+		mutex_unlock(&drv_data->device->vendor_lock);
+		/* settings written while the mouse was away */
+		if (READ_ONCE(drv_data->device->vendor_dirty))
+			queue_work(system_long_wq, &drv_data->device->vendor_work);
 	}
 
 	return 0;
+
+err_close:
+	hid_hw_close(hdev);
+err_stop:
+	hid_hw_stop(hdev);
+err_put:
+	hid_set_drvdata(hdev, NULL);
+	asus_mouse_device_put(drv_data->device);
+	return ret;
 }
 
 static void asus_mouse_remove(struct hid_device *hdev) {
@@ -381,7 +2439,16 @@ static void asus_mouse_remove(struct hid_device *hdev) {
 		return;
 	}
 
+	mutex_lock(&drv_data->device->vendor_lock);
+	if (drv_data->device->vendor == hdev)
+		WRITE_ONCE(drv_data->device->vendor, NULL);
+	mutex_unlock(&drv_data->device->vendor_lock);
+
+	device_remove_bin_file(&hdev->dev, &bin_attr_macro);
+	hid_hw_close(hdev);
 	hid_hw_stop(hdev);
+	asus_mouse_device_put(drv_data->device);
+	drv_data->device = NULL;
 	drv_data->input = NULL;
 }
 
@@ -390,43 +2457,77 @@ static void asus_mouse_remove(struct hid_device *hdev) {
   _USB devices are wireless devices connected with USB cable
 */
 static const struct hid_device_id asus_mouse_devices[] = {
-	{ HID_USB_DEVICE(USB_VENDOR_ID_ASUSTEK, USB_DEVICE_ID_ASUSTEK_ROG_BUZZARD) },
-	{ HID_USB_DEVICE(USB_VENDOR_ID_ASUSTEK, USB_DEVICE_ID_ASUSTEK_ROG_CHAKRAM_RF) },
-	{ HID_USB_DEVICE(USB_VENDOR_ID_ASUSTEK, USB_DEVICE_ID_ASUSTEK_ROG_CHAKRAM_USB) },
-	{ HID_BLUETOOTH_DEVICE(USB_VENDOR_ID_ASUSTEK, USB_DEVICE_ID_ASUSTEK_ROG_CHAKRAM_X_BT) },
-	{ HID_USB_DEVICE(USB_VENDOR_ID_ASUSTEK, USB_DEVICE_ID_ASUSTEK_ROG_CHAKRAM_X_RF) },
-	{ HID_USB_DEVICE(USB_VENDOR_ID_ASUSTEK, USB_DEVICE_ID_ASUSTEK_ROG_CHAKRAM_X_USB) },
-	{ HID_USB_DEVICE(USB_VENDOR_ID_ASUSTEK, USB_DEVICE_ID_ASUSTEK_ROG_GLADIUS2) },
-	{ HID_USB_DEVICE(USB_VENDOR_ID_ASUSTEK, USB_DEVICE_ID_ASUSTEK_ROG_GLADIUS2_CORE) },
-	{ HID_USB_DEVICE(USB_VENDOR_ID_ASUSTEK, USB_DEVICE_ID_ASUSTEK_ROG_GLADIUS2_ORIGIN) },
-	{ HID_USB_DEVICE(USB_VENDOR_ID_ASUSTEK, USB_DEVICE_ID_ASUSTEK_ROG_GLADIUS2_ORIGIN_PINK) },
-	{ HID_USB_DEVICE(USB_VENDOR_ID_ASUSTEK, USB_DEVICE_ID_ASUSTEK_ROG_GLADIUS3) },
-	{ HID_USB_DEVICE(USB_VENDOR_ID_ASUSTEK, USB_DEVICE_ID_ASUSTEK_ROG_GLADIUS3_WIRELESS) },
-	{ HID_USB_DEVICE(USB_VENDOR_ID_ASUSTEK, USB_DEVICE_ID_ASUSTEK_ROG_GLADIUS3_WIRELESS_AIMPOINT_RF) },
-	{ HID_USB_DEVICE(USB_VENDOR_ID_ASUSTEK, USB_DEVICE_ID_ASUSTEK_ROG_KERIS_WIRELESS_RF) },
-	{ HID_USB_DEVICE(USB_VENDOR_ID_ASUSTEK, USB_DEVICE_ID_ASUSTEK_ROG_KERIS_WIRELESS_USB) },
-	{ HID_USB_DEVICE(USB_VENDOR_ID_ASUSTEK, USB_DEVICE_ID_ASUSTEK_ROG_PUGIO) },
-	{ HID_USB_DEVICE(USB_VENDOR_ID_ASUSTEK, USB_DEVICE_ID_ASUSTEK_ROG_PUGIO2_RF) },
-	{ HID_USB_DEVICE(USB_VENDOR_ID_ASUSTEK, USB_DEVICE_ID_ASUSTEK_ROG_PUGIO2_USB) },
-	{ HID_USB_DEVICE(USB_VENDOR_ID_ASUSTEK, USB_DEVICE_ID_ASUSTEK_ROG_SPATHA_RF) },
-	{ HID_USB_DEVICE(USB_VENDOR_ID_ASUSTEK, USB_DEVICE_ID_ASUSTEK_ROG_SPATHA_USB) },
-	{ HID_USB_DEVICE(USB_VENDOR_ID_ASUSTEK, USB_DEVICE_ID_ASUSTEK_ROG_SPATHA_X_RF) },
-	{ HID_USB_DEVICE(USB_VENDOR_ID_ASUSTEK, USB_DEVICE_ID_ASUSTEK_ROG_SPATHA_X_USB) },
-	{ HID_USB_DEVICE(USB_VENDOR_ID_ASUSTEK, USB_DEVICE_ID_ASUSTEK_ROG_STRIX_CARRY) },
-	{ HID_USB_DEVICE(USB_VENDOR_ID_ASUSTEK, USB_DEVICE_ID_ASUSTEK_ROG_STRIX_IMPACT) },
-	{ HID_USB_DEVICE(USB_VENDOR_ID_ASUSTEK, USB_DEVICE_ID_ASUSTEK_ROG_STRIX_IMPACT2_ELECTRO_PUNK) },
-	{ HID_USB_DEVICE(USB_VENDOR_ID_ASUSTEK, USB_DEVICE_ID_ASUSTEK_ROG_STRIX_IMPACT2_WIRELESS_RF) },
-	{ HID_USB_DEVICE(USB_VENDOR_ID_ASUSTEK, USB_DEVICE_ID_ASUSTEK_ROG_STRIX_IMPACT2_WIRELESS_USB) },
-	{ HID_USB_DEVICE(USB_VENDOR_ID_ASUSTEK, USB_DEVICE_ID_ASUSTEK_TUF_GAMING_M3) },
-	{ HID_USB_DEVICE(USB_VENDOR_ID_ASUSTEK, USB_DEVICE_ID_ASUSTEK_ROG_GLADIUS3_WIRELESS_AIMPOINT_USB) },
-	{ HID_USB_DEVICE(USB_VENDOR_ID_ASUSTEK, USB_DEVICE_ID_ASUSTEK_ROG_KERIS_WIRELESS_AIMPOINT_RF) },
-	{ HID_USB_DEVICE(USB_VENDOR_ID_ASUSTEK, USB_DEVICE_ID_ASUSTEK_ROG_KERIS_WIRELESS_AIMPOINT_USB) },
+	{ HID_USB_DEVICE(USB_VENDOR_ID_ASUSTEK, USB_DEVICE_ID_ASUSTEK_ROG_BUZZARD),
+		.driver_data = (kernel_ulong_t)&asus_mouse_profile_generic },
+	{ HID_USB_DEVICE(USB_VENDOR_ID_ASUSTEK, USB_DEVICE_ID_ASUSTEK_ROG_CHAKRAM_RF),
+		.driver_data = (kernel_ulong_t)&asus_mouse_profile_chakram },
+	{ HID_USB_DEVICE(USB_VENDOR_ID_ASUSTEK, USB_DEVICE_ID_ASUSTEK_ROG_CHAKRAM_USB),
+		.driver_data = (kernel_ulong_t)&asus_mouse_profile_chakram },
+	{ HID_BLUETOOTH_DEVICE(USB_VENDOR_ID_ASUSTEK, USB_DEVICE_ID_ASUSTEK_ROG_CHAKRAM_X_BT),
+		.driver_data = (kernel_ulong_t)&asus_mouse_profile_chakram_x_bt },
+	{ HID_USB_DEVICE(USB_VENDOR_ID_ASUSTEK, USB_DEVICE_ID_ASUSTEK_ROG_CHAKRAM_X_RF),
+		.driver_data = (kernel_ulong_t)&asus_mouse_profile_chakram_x },
+	{ HID_USB_DEVICE(USB_VENDOR_ID_ASUSTEK, USB_DEVICE_ID_ASUSTEK_ROG_CHAKRAM_X_USB),
+		.driver_data = (kernel_ulong_t)&asus_mouse_profile_chakram_x },
+	{ HID_USB_DEVICE(USB_VENDOR_ID_ASUSTEK, USB_DEVICE_ID_ASUSTEK_ROG_GLADIUS2),
+		.driver_data = (kernel_ulong_t)&asus_mouse_profile_generic },
+	{ HID_USB_DEVICE(USB_VENDOR_ID_ASUSTEK, USB_DEVICE_ID_ASUSTEK_ROG_GLADIUS2_CORE),
+		.driver_data = (kernel_ulong_t)&asus_mouse_profile_gladius2_core },
+	{ HID_USB_DEVICE(USB_VENDOR_ID_ASUSTEK, USB_DEVICE_ID_ASUSTEK_ROG_GLADIUS2_ORIGIN),
+		.driver_data = (kernel_ulong_t)&asus_mouse_profile_generic },
+	{ HID_USB_DEVICE(USB_VENDOR_ID_ASUSTEK, USB_DEVICE_ID_ASUSTEK_ROG_GLADIUS2_ORIGIN_PINK),
+		.driver_data = (kernel_ulong_t)&asus_mouse_profile_generic },
+	{ HID_USB_DEVICE(USB_VENDOR_ID_ASUSTEK, USB_DEVICE_ID_ASUSTEK_ROG_GLADIUS3),
+		.driver_data = (kernel_ulong_t)&asus_mouse_profile_gladius3 },
+	{ HID_USB_DEVICE(USB_VENDOR_ID_ASUSTEK, USB_DEVICE_ID_ASUSTEK_ROG_GLADIUS3_WIRELESS),
+		.driver_data = (kernel_ulong_t)&asus_mouse_profile_gladius3 },
+	{ HID_USB_DEVICE(USB_VENDOR_ID_ASUSTEK, USB_DEVICE_ID_ASUSTEK_ROG_GLADIUS3_WIRELESS_AIMPOINT_RF),
+		.driver_data = (kernel_ulong_t)&asus_mouse_profile_aimpoint },
+	{ HID_USB_DEVICE(USB_VENDOR_ID_ASUSTEK, USB_DEVICE_ID_ASUSTEK_ROG_KERIS_WIRELESS_RF),
+		.driver_data = (kernel_ulong_t)&asus_mouse_profile_keris },
+	{ HID_USB_DEVICE(USB_VENDOR_ID_ASUSTEK, USB_DEVICE_ID_ASUSTEK_ROG_KERIS_WIRELESS_USB),
+		.driver_data = (kernel_ulong_t)&asus_mouse_profile_keris },
+	{ HID_USB_DEVICE(USB_VENDOR_ID_ASUSTEK, USB_DEVICE_ID_ASUSTEK_ROG_PUGIO),
+		.driver_data = (kernel_ulong_t)&asus_mouse_profile_pugio },
+	{ HID_USB_DEVICE(USB_VENDOR_ID_ASUSTEK, USB_DEVICE_ID_ASUSTEK_ROG_PUGIO2_RF),
+		.driver_data = (kernel_ulong_t)&asus_mouse_profile_keris },
+	{ HID_USB_DEVICE(USB_VENDOR_ID_ASUSTEK, USB_DEVICE_ID_ASUSTEK_ROG_PUGIO2_USB),
+		.driver_data = (kernel_ulong_t)&asus_mouse_profile_keris },
+	{ HID_USB_DEVICE(USB_VENDOR_ID_ASUSTEK, USB_DEVICE_ID_ASUSTEK_ROG_SPATHA_RF),
+		.driver_data = (kernel_ulong_t)&asus_mouse_profile_spatha },
+	{ HID_USB_DEVICE(USB_VENDOR_ID_ASUSTEK, USB_DEVICE_ID_ASUSTEK_ROG_SPATHA_USB),
+		.driver_data = (kernel_ulong_t)&asus_mouse_profile_spatha },
+	{ HID_USB_DEVICE(USB_VENDOR_ID_ASUSTEK, USB_DEVICE_ID_ASUSTEK_ROG_SPATHA_X_RF),
+		.driver_data = (kernel_ulong_t)&asus_mouse_profile_gladius3 },
+	{ HID_USB_DEVICE(USB_VENDOR_ID_ASUSTEK, USB_DEVICE_ID_ASUSTEK_ROG_SPATHA_X_USB),
+		.driver_data = (kernel_ulong_t)&asus_mouse_profile_gladius3 },
+	{ HID_USB_DEVICE(USB_VENDOR_ID_ASUSTEK, USB_DEVICE_ID_ASUSTEK_ROG_STRIX_CARRY),
+		.driver_data = (kernel_ulong_t)&asus_mouse_profile_pugio },
+	{ HID_USB_DEVICE(USB_VENDOR_ID_ASUSTEK, USB_DEVICE_ID_ASUSTEK_ROG_STRIX_IMPACT),
+		.driver_data = (kernel_ulong_t)&asus_mouse_profile_strix_impact },
+	{ HID_USB_DEVICE(USB_VENDOR_ID_ASUSTEK, USB_DEVICE_ID_ASUSTEK_ROG_STRIX_IMPACT2_ELECTRO_PUNK),
+		.driver_data = (kernel_ulong_t)&asus_mouse_profile_gladius2_core },
+	{ HID_USB_DEVICE(USB_VENDOR_ID_ASUSTEK, USB_DEVICE_ID_ASUSTEK_ROG_STRIX_IMPACT2_WIRELESS_RF),
+		.driver_data = (kernel_ulong_t)&asus_mouse_profile_keris },
+	{ HID_USB_DEVICE(USB_VENDOR_ID_ASUSTEK, USB_DEVICE_ID_ASUSTEK_ROG_STRIX_IMPACT2_WIRELESS_USB),
+		.driver_data = (kernel_ulong_t)&asus_mouse_profile_keris },
+	{ HID_USB_DEVICE(USB_VENDOR_ID_ASUSTEK, USB_DEVICE_ID_ASUSTEK_TUF_GAMING_M3),
+		.driver_data = (kernel_ulong_t)&asus_mouse_profile_tuf_m3 },
+	{ HID_USB_DEVICE(USB_VENDOR_ID_ASUSTEK, USB_DEVICE_ID_ASUSTEK_ROG_GLADIUS3_WIRELESS_AIMPOINT_USB),
+		.driver_data = (kernel_ulong_t)&asus_mouse_profile_aimpoint },
+	{ HID_USB_DEVICE(USB_VENDOR_ID_ASUSTEK, USB_DEVICE_ID_ASUSTEK_ROG_KERIS_WIRELESS_AIMPOINT_RF),
+		.driver_data = (kernel_ulong_t)&asus_mouse_profile_aimpoint },
+	{ HID_USB_DEVICE(USB_VENDOR_ID_ASUSTEK, USB_DEVICE_ID_ASUSTEK_ROG_KERIS_WIRELESS_AIMPOINT_USB),
+		.driver_data = (kernel_ulong_t)&asus_mouse_profile_aimpoint },
 	{ }
 };
 MODULE_DEVICE_TABLE(hid, asus_mouse_devices);
 
 static struct hid_driver asus_mouse_driver = {
 	.name = "hid-asus-mouse",
+	.driver = {
+		.dev_groups = asus_mouse_groups,
+	},
 	.id_table = asus_mouse_devices,
 	.probe = asus_mouse_probe,
 	.remove = asus_mouse_remove,
@@ -437,66 +2538,35 @@ static int __init asus_mouse_init(void) {
 	int ret;
 	pr_info("hid-asus-mouse: loading ASUS mouse driver\n");
 
-	asus_mouse_state.joystick_x = 0;
-	asus_mouse_state.joystick_y = 0;
-	asus_mouse_state.ktime_start = 0;
+	if (!per_device_input) {
+		asus_mouse_input = asus_mouse_input_create("hid-asus-mouse", NULL, NULL, asus_mouse_keymap);
+		if (IS_ERR(asus_mouse_input))
+			return PTR_ERR(asus_mouse_input);
+	}
 
-	asus_mouse_input = input_allocate_device();
-	if (!asus_mouse_input)
-		return -ENOMEM;
+	asus_mouse_debugfs_root = debugfs_create_dir("hid-asus-mouse", NULL);
 
-	asus_mouse_input->name = "ASUS mouse input";
-	asus_mouse_input->phys = "hid-asus-mouse";
-
-	asus_mouse_input->id.bustype = BUS_VIRTUAL;
-	asus_mouse_input->id.product = 0x0000;
-	asus_mouse_input->id.vendor = 0x0000;
-	asus_mouse_input->id.version = 0x0000;
-
-	asus_mouse_input->keybit[3] = 0x1000300000007;
-	asus_mouse_input->keybit[2] = 0xff800078000007ff;
-	asus_mouse_input->keybit[1] = 0xfebeffdff3cfffff;
-	asus_mouse_input->keybit[0] = 0xfffffffffffffffe;
-
-	set_bit(EV_REL, asus_mouse_input->evbit);
-	set_bit(EV_KEY, asus_mouse_input->evbit);
-
-	set_bit(REL_X, asus_mouse_input->relbit);
-	set_bit(REL_Y, asus_mouse_input->relbit);
-	set_bit(REL_WHEEL, asus_mouse_input->relbit);
-	set_bit(REL_WHEEL_HI_RES, asus_mouse_input->relbit);
-	set_bit(REL_HWHEEL, asus_mouse_input->relbit);
-	set_bit(REL_HWHEEL_HI_RES, asus_mouse_input->relbit);
-
-	set_bit(BTN_LEFT, asus_mouse_input->keybit);
-	set_bit(BTN_RIGHT, asus_mouse_input->keybit);
-	set_bit(BTN_MIDDLE, asus_mouse_input->keybit);
-	set_bit(BTN_BACK, asus_mouse_input->keybit);
-	set_bit(BTN_FORWARD, asus_mouse_input->keybit);
-	set_bit(BTN_TOOL_DOUBLETAP, asus_mouse_input->keybit);
-	set_bit(KEY_BACK, asus_mouse_input->keybit);
-	set_bit(KEY_FORWARD, asus_mouse_input->keybit);
-
-	asus_mouse_input->rep[REP_PERIOD] = 16;
-	timer_setup(&asus_mouse_input->timer, input_repeat_key, 0);
-
-	ret = input_register_device(asus_mouse_input);
+	ret = asus_mouse_capture_init();
+	if (!ret)
+		ret = hid_register_driver(&asus_mouse_driver);
 	if (ret) {
-		input_free_device(asus_mouse_input);
-		return ret;
+		debugfs_remove_recursive(asus_mouse_debugfs_root);
+		vfree(asus_mouse_capture.buf);
+		if (asus_mouse_input)
+			input_unregister_device(asus_mouse_input);
 	}
 
-	return hid_register_driver(&asus_mouse_driver);
+	return ret;
 }
 
 static void __exit asus_mouse_exit(void) {
 	pr_info("hid-asus-mouse: unloading ASUS mouse driver\n");
 
-	asus_mouse_input->repeat_key = 0;
-	del_timer(&asus_mouse_input->timer);
-
 	hid_unregister_driver(&asus_mouse_driver);
-	input_unregister_device(asus_mouse_input);
+	debugfs_remove_recursive(asus_mouse_debugfs_root);
+	vfree(asus_mouse_capture.buf);
+	if (asus_mouse_input)
+		input_unregister_device(asus_mouse_input);
 }
 
 module_init(asus_mouse_init);
@@ -505,3 +2575,7 @@ module_exit(asus_mouse_exit);
 MODULE_AUTHOR("Kyoken <kyoken@kyoken.ninja>");
 MODULE_DESCRIPTION("ASUS Mouse");
 MODULE_LICENSE("GPL");
+
+#ifdef ASUS_MOUSE_KUNIT_TEST
+#include "hid-asus-mouse-test.c"
+#endif
@@ -6,6 +6,8 @@
  * Copyright (c) 2022 Kyoken <kyoken@kyoken.ninja>
  */
 
+#include "hid-asus-mouse-core.h"
+
 /* TODO: move to hid-ids.h */
 #define USB_VENDOR_ID_ASUSTEK 0x0b05
 #define USB_DEVICE_ID_ASUSTEK_ROG_BUZZARD 0x1816
@@ -32,7 +34,7 @@
 #define USB_DEVICE_ID_ASUSTEK_ROG_SPATHA_RF 0x1824
 #define USB_DEVICE_ID_ASUSTEK_ROG_SPATHA_USB 0x181c
 #define USB_DEVICE_ID_ASUSTEK_ROG_SPATHA_X_RF 0x1879
-#define USB_DEVICE_ID_ASUSTEK_ROG_SPATHA_X_USB 0x1877
+#define USB_DEVICE_ID_ASUSTEK_ROG_SPATHA_X_USB 0x1877  /* same as the Gladius II Origin */
 #define USB_DEVICE_ID_ASUSTEK_ROG_STRIX_CARRY 0x18b4
 #define USB_DEVICE_ID_ASUSTEK_ROG_STRIX_IMPACT 0x1847
 #define USB_DEVICE_ID_ASUSTEK_ROG_STRIX_IMPACT2_ELECTRO_PUNK 0x1956
@@ -40,31 +42,214 @@
 #define USB_DEVICE_ID_ASUSTEK_ROG_STRIX_IMPACT2_WIRELESS_USB 0x1947
 #define USB_DEVICE_ID_ASUSTEK_TUF_GAMING_M3 0x1910
 
-// #define ASUS_MOUSE_DEBUG 1
-
-#define ASUS_MOUSE_KEYS_BITMASK_EVENT_SIZE 17
-
-#define ASUS_MOUSE_MOUSE_WHEEL_RES 120  /* generic mouse wheel resolution */
+/* default keypad emulated wheel curve */
 #define ASUS_MOUSE_KP_WHEEL_RES_MIN 10  /* keypad emulated wheel resolution min */
 #define ASUS_MOUSE_KP_WHEEL_RES_MAX 100  /* keypad emulated wheel resolution max */
-#define ASUS_MOUSE_KP_WHEEL_TIME_NS 3000000000
+#define ASUS_MOUSE_KP_WHEEL_TIME_MS 3000  /* time to reach the max resolution */
+
+/* default joystick scrolling, a quarter of the offset per base period */
 #define ASUS_MOUSE_JOYSTICK_DEADZONE 16
+#define ASUS_MOUSE_JOYSTICK_FILTER 2
+#define ASUS_MOUSE_JOYSTICK_RES_MAX 32
 
-#define ASUS_MOUSE_DATA_KEY_STATE_BITS 32  /* size of "key_state" item in bits */
-#define ASUS_MOUSE_DATA_KEY_STATE_NUM 4  /* number of "key_state" items */
-struct asus_mouse_data {
+/* default kinetic scrolling, a notch glides for about half a second */
+#define ASUS_MOUSE_KINETIC_FRICTION 15
+#define ASUS_MOUSE_KINETIC_GAIN 100
+
+#define ASUS_MOUSE_COALESCE_RATE_HZ_MIN 10  /* 0 turns coalescing off */
+#define ASUS_MOUSE_COALESCE_RATE_HZ_MAX 8000
+
+#define ASUS_MOUSE_SCROLL_PERIOD_US 1000  /* default scroll timer tick */
+#define ASUS_MOUSE_SCROLL_PERIOD_US_MIN 250
+#define ASUS_MOUSE_SCROLL_PERIOD_US_MAX 100000
+
+#define ASUS_MOUSE_POINTER_SCALE 100  /* percent, default */
+#define ASUS_MOUSE_POINTER_GAIN 100  /* percent, default flat curve */
+
+#define ASUS_MOUSE_CAPTURE_RECORDS_MAX (1 << 20)  /* 96 MiB of capture ring */
+
+#define ASUS_MOUSE_DEDUP_QUIET_MS 100  /* before the standby path of a mouse takes over */
+
+/*
+ * Configuration commands go to the vendor interface as output reports, the
+ * mouse answers with an input report starting with the same command:
+ *   <command, le16> <field> 0x00 <value, le16> 0x00...
+ * Settings are fields of ASUS_MOUSE_CMD_SET_SETTING: the DPI stages come
+ * first, then the polling rate, button response, angle snapping and lift-off
+ * distance. ASUS_MOUSE_CMD_SAVE stores them in the mouse.
+ */
+#define ASUS_MOUSE_VENDOR_PAGE 0xff01  /* usage page of the vendor interface */
+#define ASUS_MOUSE_VENDOR_CMD_SIZE 6  /* bytes used by a command */
+#define ASUS_MOUSE_VENDOR_TIMEOUT_MS 500
+#define ASUS_MOUSE_VENDOR_RETRIES 2  /* more tries of an unanswered command */
+#define ASUS_MOUSE_VENDOR_FIELDS 8
+#define ASUS_MOUSE_CMD_SET_SETTING 0x3151
+#define ASUS_MOUSE_CMD_SAVE 0x0350
+#define ASUS_MOUSE_FIELD_RATE(dpi_stages) ((dpi_stages) + 0)
+#define ASUS_MOUSE_FIELD_LIFTOFF(dpi_stages) ((dpi_stages) + 3)
+#define ASUS_MOUSE_DPI_UNIT 50  /* DPI values are sent in these units, minus one */
+#define ASUS_MOUSE_DPI_STAGES_MAX 4
+#define ASUS_MOUSE_RATES 7  /* 125 Hz to 8000 Hz */
+
+#ifdef __KERNEL__
+#define ASUS_MOUSE_HIST_BUCKETS 32  /* log2 of ns, the last one takes everything above 1 s */
+
+/* lock-free log2 histogram of durations in ns */
+struct asus_mouse_hist {
+	atomic_long_t bucket[ASUS_MOUSE_HIST_BUCKETS];
+};
+
+/* raw report capture ring shared by all the interfaces, see hid-asus-mouse-core.h */
+struct asus_mouse_capture_ring {
+	void *buf;  /* header page and records, mapped to userspace as is */
+	size_t size;
+	struct asus_mouse_capture_record *records;
+	u32 mask;
+	atomic64_t next;  /* index of the next record to write */
+};
+
+#define ASUS_MOUSE_STATS_SIZES 65  /* report lengths, the last one counts longer ones too */
+
+/*
+ * Per-CPU counters, summed on read. Interfaces count their reports,
+ * the device shared by them counts its timers.
+ */
+struct asus_mouse_stats {
+	unsigned long reports_mouse;
+	unsigned long reports_keyboard;
+	unsigned long reports_gamepad;
+	unsigned long reports_other;
+	unsigned long reports_size[ASUS_MOUSE_STATS_SIZES];
+	unsigned long dropped;  /* reports of an unknown layout or length */
+	unsigned long key_presses;
+	unsigned long scroll_timer;  /* scroll timer callbacks */
+	unsigned long coalesce_merged;  /* motion reports folded into a pending frame */
+	unsigned long coalesce_frames;  /* frames flushed to the input device */
+	unsigned long vendor_commands;  /* configuration commands sent */
+	unsigned long vendor_merged;  /* settings replaced before they were sent */
+	unsigned long vendor_retries;
+	unsigned long vendor_timeouts;  /* commands not answered in time */
+	unsigned long vendor_failed;  /* commands given up on */
+	unsigned long suppressed;  /* reports of the standby path of a mouse bound twice */
+	unsigned long path_switches;  /* times the path of a mouse bound twice became the active one */
+};
+
+/* state shared by all the interfaces of one physical mouse */
+struct asus_mouse_device {
+	struct list_head list;
+	char name[96];  /* of the physical mouse, the interfaces sharing it share the device */
+	struct device *parent;  /* USB device of the interfaces, NULL on other buses */
+	unsigned int users;  /* bound interfaces */
+	char phys[112];
 	struct input_dev *input;
-	__u32 key_state[ASUS_MOUSE_DATA_KEY_STATE_NUM];
+	bool own_input;  /* "input" belongs to this device and not to the module */
+	unsigned short keymap[ASUS_MOUSE_MAPPING_SIZE];  /* of the own "input" */
+	u16 product;  /* of an ASUS mouse, 0 for the others */
+
+	/*
+	 * The same mouse bound through its RF receiver and its cable at once: only
+	 * the reports of the active path are decoded. The state of the pair is kept
+	 * on the cable side.
+	 */
+	struct asus_mouse_device __rcu *peer;  /* protected by "asus_mouse_device_lock" */
+	bool link_usb;  /* this is the cable side */
+	struct asus_mouse_device *link_active;  /* on the cable side, NULL until a report */
+	u64 last_report_ns;  /* last decoded report of a linked path */
+	unsigned int path_epoch;  /* bumped every time this path takes over */
+
+	spinlock_t lock;  /* protects the scroll state below against the timer */
+	struct hrtimer scroll_timer;
+	unsigned int scroll_period_us;
+	ktime_t scroll_period;
+	s32 scroll_rem[2];  /* sub-unit remainders of wheel and hwheel, 16.16 */
+	unsigned int scroll_ticks;  /* ticks since the wheel key was pressed */
+	struct asus_mouse_curve scroll_curve;
+	struct asus_mouse_curve_lut scroll_lut;  /* "scroll_curve" for the current tick */
+	unsigned int repeat_key;
+	DECLARE_BITMAP(keys_down, KEY_CNT);  /* pressed through this device, released when its path loses */
+	struct asus_mouse_joystick joystick;
+	bool kinetic_scroll;
+	struct asus_mouse_kinetic kinetic;
+	struct asus_mouse_pointer pointer;  /* scaling and acceleration of the motion */
+
+	/* mouse motion merged into frames of at most "coalesce_rate_hz" */
+	struct hrtimer coalesce_timer;
+	unsigned int coalesce_rate_hz;
+	ktime_t coalesce_period;
+	ktime_t coalesce_next;  /* earliest time the next frame may go out */
+	ktime_t coalesce_last;  /* arrival of the last report merged into the pending frame */
+	bool coalesce_pending;
+	s32 coalesce_rel[REL_CNT];
+
+	/* macros played from a timer instead of their trigger keys */
+	struct hrtimer macro_timer;
+	struct asus_mouse_macro macros[ASUS_MOUSE_MACROS_MAX];  /* trigger 0 for free slots */
+	unsigned int macros_num;
+	unsigned long macros_held;  /* triggers down, by slot */
+	const struct asus_mouse_macro *macro;  /* playing, NULL when idle */
+	unsigned int macro_step;  /* next step to play */
+	DECLARE_BITMAP(macro_keys, KEY_CNT);  /* pressed by the playing macro */
+
+	/* vendor interface taking configuration commands, NULL until one is bound */
+	struct mutex vendor_lock;  /* serializes commands with the binding of the interface */
+	struct hid_device *vendor;
+	struct hid_report *vendor_report;
+	struct completion vendor_done;
+	u16 vendor_cmd;  /* command waiting for its answer */
+	struct work_struct vendor_work;  /* sends the dirty settings */
+	unsigned long vendor_dirty;  /* settings not sent yet, by field, protected by "lock" */
+	u16 vendor_values[ASUS_MOUSE_VENDOR_FIELDS];  /* protected by "lock" */
+	unsigned int polling_rate;  /* last values written, 0 while unknown */
+	unsigned int dpi[ASUS_MOUSE_DPI_STAGES_MAX];
+	int liftoff;  /* -1 while unknown */
+
+	struct asus_mouse_stats __percpu *stats;
+	struct dentry *debugfs;
+	struct asus_mouse_hist raw_event_hist;  /* raw_event entry to its last input_sync */
+	struct asus_mouse_hist report_interval_hist;  /* between reports of a mouse interface */
+	struct asus_mouse_hist scroll_lateness_hist;  /* scroll timer expiry to its callback */
 };
 
-struct asus_mouse_state {
-	int joystick_x;
-	int joystick_y;
-	u64 ktime_start;
+/* product IDs of one mouse through its RF receiver and through its cable */
+struct asus_mouse_pair {
+	u16 rf;
+	u16 usb;
 };
 
-#define ASUS_MOUSE_MAPPING_SIZE 98
-static unsigned char asus_mouse_key_mapping[] = {
+/* what a product can do, in "driver_data" of its device ID */
+struct asus_mouse_profile {
+	unsigned int caps;
+	unsigned int dpi_stages;  /* 0 if the DPI can't be set */
+	unsigned int dpi_min;
+	unsigned int dpi_max;
+	unsigned int dpi_step;
+	unsigned int rates;  /* supported polling rates, bit i for 125 << i Hz */
+	unsigned int liftoff_levels;  /* 0 if the lift-off distance can't be set */
+};
+
+/* decoder of one input report, resolved at probe */
+struct asus_mouse_report {
+	asus_mouse_decode_t decode;
+	unsigned int application;  /* 0 for applications the driver ignores */
+	int size;  /* 0 if the layout is unknown */
+};
+
+/* state of one bound interface */
+struct asus_mouse_data {
+	struct asus_mouse_device *device;
+	struct input_dev *input;
+	const struct asus_mouse_profile *profile;
+	struct asus_mouse_decoder decoder;
+	struct asus_mouse_events events;  /* decoder output, reused for every report */
+	struct asus_mouse_stats __percpu *stats;
+	ktime_t last_report;  /* arrival of the previous mouse report */
+	unsigned int path_epoch;  /* of the device when the decoder state was last valid */
+	struct asus_mouse_report reports[HID_MAX_IDS];  /* by report ID */
+};
+#endif
+
+/* default keymap, every input device gets a remappable copy of it */
+static const unsigned short asus_mouse_key_mapping[] = {
 /* 00 */	0,		0,		0,		0,
 /* 04 */	KEY_A,		KEY_B,		KEY_C,		KEY_D,
 /* 08 */	KEY_E,		KEY_F,		KEY_G,		KEY_H,